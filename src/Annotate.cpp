@@ -55,6 +55,7 @@ static const int UPPER_MAX = 110; // upper hand at between 0.6 pawns and 1.1 paw
 
 static const int MISSED_MARGIN = 25; // margin for a missed good move
 static const int BLUNDER_MARGIN = 105; // we blundered if we missed a move with a score at least this much greater
+static const size_t ANNOTATE_LINES = 4; // number of PV lines to search (so the move played usually gets scored by the same search)
 
 // Annotator Methods //
 
@@ -117,7 +118,10 @@ PGN_Move Annotator::annotate(Move move){
 	int64_t nodes; // stop at a certain number of nodes
 	*/
 	Search::Limits = limits;
+	const size_t old_multipv = Search::MultiPV;
+	Search::MultiPV = ANNOTATE_LINES;
 	search_for(ap.time_per, BSS);
+	Search::MultiPV = old_multipv;
 	printf("A1\n");
 	Search::RootMove best_line = Search::LastBest, other_best_line(MOVE_NONE);
 	Move best = Search::LastBest.pv[0];
@@ -128,9 +132,20 @@ PGN_Move Annotator::annotate(Move move){
 	BSS = Search::BoardStateStack(new std::stack<BoardState>());
 	printf("A3\n");
 	Ann_Advantage next_adv = cur_adv;
-	// If the best move and played move differ, search the played move. //
+	// If the best move and played move differ, we need the score of the played move. //
 	printf("A5\n");
-	if(best != move){
+	bool found = (best == move);
+	for(size_t i = 0; !found && (i < std::min(ANNOTATE_LINES, Search::RootMoves.size())); i++){
+		if((Search::RootMoves[i].pv[0] == move) && (Search::RootMoves[i].score != -VAL_INF)){
+			// It was one of the lines we searched (to at least one depth), so no need for another search. //
+			found = true;
+			other_best_score = Value(Search::RootMoves[i].score * 100 / PawnValueEg);
+			other_best_line = Search::RootMoves[i];
+			next_adv = get_advantage(other_best_score, board);
+		}
+	}
+	if(!found){
+		// Otherwise, search the played move on its own. //
 		printf("A5B\n");
 		std::memset(&limits, 0, sizeof(limits));
 		limits.SearchMoves.clear();
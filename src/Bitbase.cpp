@@ -0,0 +1,124 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Endgame.h"
+#include <vector>
+
+/*
+* KPK bitbase: one bit (win/draw) for every position with the pawn on files A-D (the others are mirrored),
+* so 2 sides * 24 pawn squares * 64 * 64 king squares = 196608 positions in 24 KB.
+* It is built at startup by retrograde analysis: positions with an immediate result are classified first,
+* then every position is classified from its successors over and over until nothing changes anymore.
+*/
+
+namespace {
+	const unsigned MaxIndex = 2 * 24 * 64 * 64; // side to move * pawn squares * strong king squares * weak king squares
+	uint32_t KPKBitbase[MaxIndex / 32]; // one bit per position (1 = win for the strong side)
+
+	// Index layout: bits 0-5 = strong king, 6-11 = weak king, 12 = side to move, 13-14 = pawn file, 15-17 = RANK_7 - pawn rank //
+	inline unsigned index(Side us, Square bksq, Square wksq, Square psq){
+		return unsigned(wksq) | (unsigned(bksq) << 6) | (unsigned(us) << 12) | (unsigned(file_of(psq)) << 13) | (unsigned(RANK_7 - rank_of(psq)) << 15);
+	}
+
+	enum Result {
+		INVALID = 0,
+		UNKNOWN = 1,
+		DRAW = 2,
+		WIN = 4
+	};
+
+	inline Result& operator|=(Result& r, Result v){
+		return r = Result(r | v);
+	}
+
+	struct KPKPosition {
+		Side us; // side to move (WHITE = the side with the pawn)
+		Square ksq[SIDE_NB]; // king squares
+		Square psq; // pawn square
+		Result result;
+
+		KPKPosition(void){ }
+		explicit KPKPosition(unsigned idx);
+
+		operator Result(void) const {
+			return result;
+		}
+
+		Result classify(const std::vector<KPKPosition>& db){
+			return (us == WHITE) ? classify<WHITE>(db) : classify<BLACK>(db);
+		}
+
+		template<Side Us> Result classify(const std::vector<KPKPosition>& db);
+	};
+
+	KPKPosition::KPKPosition(unsigned idx){
+		ksq[WHITE] = Square((idx >> 0) & 0x3F);
+		ksq[BLACK] = Square((idx >> 6) & 0x3F);
+		us = Side((idx >> 12) & 0x01);
+		psq = make_square(Rank(RANK_7 - ((idx >> 15) & 0x7)), File((idx >> 13) & 0x3));
+		const Square promo_sq = psq + DELTA_N;
+		if((distance(ksq[WHITE], ksq[BLACK]) <= 1) || (ksq[WHITE] == psq) || (ksq[BLACK] == psq) || ((us == WHITE) && (StepAttacksBB[W_PAWN][psq] & ksq[BLACK]))){
+			// Two pieces on one square, or a king that can be captured. //
+			result = INVALID;
+		} else if((us == WHITE) && (rank_of(psq) == RANK_7) && (ksq[WHITE] != promo_sq)
+				&& ((distance(ksq[BLACK], promo_sq) > 1) || (StepAttacksBB[W_KING][ksq[WHITE]] & promo_sq))){
+			// The pawn promotes and the new queen cannot be taken. //
+			result = WIN;
+		} else if((us == BLACK)
+				&& (!(StepAttacksBB[W_KING][ksq[BLACK]] & ~(StepAttacksBB[W_KING][ksq[WHITE]] | StepAttacksBB[W_PAWN][psq]))
+				|| (StepAttacksBB[W_KING][ksq[BLACK]] & psq & ~StepAttacksBB[W_KING][ksq[WHITE]]))){
+			// Stalemate, or the weak king takes the undefended pawn. //
+			result = DRAW;
+		} else {
+			result = UNKNOWN;
+		}
+	}
+
+	template<Side Us>
+	Result KPKPosition::classify(const std::vector<KPKPosition>& db){
+		// A position is won for white if any white move wins, and drawn if any black move draws. //
+		const Side Them = (Us == WHITE) ? BLACK : WHITE;
+		const Result Good = (Us == WHITE) ? WIN : DRAW;
+		const Result Bad = (Us == WHITE) ? DRAW : WIN;
+		Result r = INVALID;
+		Bitboard b = StepAttacksBB[W_KING][ksq[Us]];
+		while(b){
+			const Square s = pop_lsb(&b);
+			r |= (Us == WHITE) ? db[index(Them, ksq[Them], s, psq)] : db[index(Them, s, ksq[Them], psq)];
+		}
+		if(Us == WHITE){
+			if(rank_of(psq) < RANK_7){ // single push
+				r |= db[index(Them, ksq[Them], ksq[Us], psq + DELTA_N)];
+			}
+			if((rank_of(psq) == RANK_2) && (psq + DELTA_N != ksq[Us]) && (psq + DELTA_N != ksq[Them])){ // double push
+				r |= db[index(Them, ksq[Them], ksq[Us], psq + DELTA_N + DELTA_N)];
+			}
+		}
+		return result = (r & Good) ? Good : ((r & UNKNOWN) ? UNKNOWN : Bad);
+	}
+}
+
+void Bitbases::init(void){
+	std::vector<KPKPosition> db(MaxIndex);
+	unsigned idx, repeat = 1;
+	for(idx = 0; idx < MaxIndex; idx++){
+		db[idx] = KPKPosition(idx);
+	}
+	// Keep going until a pass classifies nothing new (whatever is still unknown then is a draw). //
+	while(repeat){
+		for(repeat = idx = 0; idx < MaxIndex; idx++){
+			repeat |= ((db[idx] == UNKNOWN) && (db[idx].classify(db) != UNKNOWN));
+		}
+	}
+	std::memset(KPKBitbase, 0, sizeof(KPKBitbase));
+	for(idx = 0; idx < MaxIndex; idx++){
+		if(db[idx] == WIN){
+			KPKBitbase[idx / 32] |= 1 << (idx & 0x1F);
+		}
+	}
+}
+
+bool Bitbases::probe_kpk(Square wksq, Square wpsq, Square bksq, Side us){
+	assert(file_of(wpsq) <= FILE_D);
+	const unsigned idx = index(us, bksq, wksq, wpsq);
+	return KPKBitbase[idx / 32] & (1 << (idx & 0x1F));
+}
@@ -84,7 +84,7 @@ void Bitboards::init(void){
 	for(Square i = SQ_A1; i <= SQ_H8; i++){
 		for(Square j = SQ_A1; j <= SQ_H8; j++){
 			SquareDistance[i][j] = std::max(distance<Rank>(i, j), distance<File>(i, j));
-			DistanceRingBB[i][SquareDistance[i][j] - 1] |= i; // overloaded for adding in a square
+			if(i != j) DistanceRingBB[i][SquareDistance[i][j] - 1] |= j; // overloaded for adding in a square
 		}
 	}
 	/* StepAttacksBB */
@@ -160,6 +160,13 @@ void init_magics(Bitboard table[], Bitboard* attacks[], Bitboard magics[], Bitbo
 		} while (b);
 		// Find offset of next square in table //
 		if(s < SQ_H8) attacks[s + 1] = attacks[s] + size;
+		if(SliderIndex == IDX_PEXT){
+			// PEXT indexes are perfect by construction, so there is no magic to look for. //
+			for(i = 0; i < size; i++){
+				attacks[s][index(s, occupancy[i])] = reference[i];
+			}
+			continue;
+		}
 		RNG rng(seeds[1][rank_of(s)]); // 1 = Is64Bit
 		// Find a magic that passes the test, and in the process
 		// build an attack table.
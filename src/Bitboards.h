@@ -201,7 +201,7 @@ inline unsigned magic_index(Square s, Bitboard occupied){
 	Bitboard* const Masks = Pt == ROOK ? RookMasks  : BishopMasks;
 	Bitboard* const Magics = Pt == ROOK ? RookMagics : BishopMagics;
 	unsigned* const Shifts = Pt == ROOK ? RookShifts : BishopShifts;
-	return unsigned(((occupied & Masks[s]) * Magics[s]) >> Shifts[s]);
+	return slider_index<SliderIndex>(occupied, Masks[s], Magics[s], Shifts[s]);
 }
 
 template<PieceType Pt>
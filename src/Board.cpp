@@ -19,6 +19,15 @@ namespace Hashing {
 
 const std::string PieceChar(" PNBRQK  pnbrqk");
 
+namespace {
+	// Cuckoo tables of the key changes of every reversible (non-pawn) move, for has_game_cycle(). //
+	// Note: Each move and its reverse have the same key, so only one is stored.
+	Key cuckoo[8192];
+	Move cuckoo_move[8192];
+	inline int H1(Key h){ return h & 0x1FFF; }
+	inline int H2(Key h){ return (h >> 16) & 0x1FFF; }
+}
+
 void Board::clear(void){
 	std::memset(this, 0, sizeof(Board));
 	orig_st.epsq = SQ_NONE;
@@ -41,11 +50,37 @@ void Board::init(void){
 		Hashing::castling[cr] = rng.rand<Key>();
 	}
 	Hashing::side = rng.rand<Key>();
+	// Cuckoo Tables //
+	std::memset(cuckoo, 0, sizeof(cuckoo));
+	std::memset(cuckoo_move, 0, sizeof(cuckoo_move));
+	int count = 0;
+	for(Side c = WHITE; c <= BLACK; c++){
+		for(PieceType pt = KNIGHT; pt <= KING; pt++){
+			for(Square s1 = SQ_A1; s1 <= SQ_H8; s1++){
+				for(Square s2 = Square(s1 + 1); s2 <= SQ_H8; s2++){
+					if(!(attacks_bb(make_piece(c, pt), s1, 0) & s2)) continue;
+					Move move = make_move(s1, s2);
+					Key key = Hashing::psq[c][pt][s1] ^ Hashing::psq[c][pt][s2] ^ Hashing::side;
+					int i = H1(key);
+					while(true){
+						// Keep kicking out whatever is in our slot to its other slot until an empty one is found. //
+						std::swap(cuckoo[i], key);
+						std::swap(cuckoo_move[i], move);
+						if(move == MOVE_NONE) break;
+						i = (i == H1(key)) ? H2(key) : H1(key);
+					}
+					count++;
+				}
+			}
+		}
+	}
+	assert(count == 3668);
 }
 
 Board& Board::operator=(const Board& pos){
 	std::memcpy(this, &pos, sizeof(Board));
 	orig_st = *st;
+	orig_st.dirty.num = -1; // the accumulator is still good, but the other board's states may not stay around
 	st = &orig_st;
 	return *this;
 }
@@ -117,10 +152,13 @@ void Board::update_state(BoardState* st){
 	assert(st == &orig_st);
 	st->key = st->pawn_key = st->material_key = 0;
 	st->capd = NO_PIECE_TYPE;
+	st->repetition = 0;
+	st->dirty.num = -1; // nothing to update the accumulator from
+	st->accumulator.net_id = 0;
 	Square ksq = king_sq(to_move);
 	st->checkers = attackers_to(ksq, byType[ALL_PIECES]) & pieces(~to_move);
-	st->pinned = pinned(to_move);
-	st->lined = lined(to_move);
+	st->pinned = check_blockers(to_move, to_move);
+	st->lined = check_blockers(to_move, ~to_move);
 	// And now for regenerating hash keys. //
 	// First, Zobrist hash for entire board. //
 	for(Bitboard b = all(); b; ){
@@ -137,6 +175,19 @@ void Board::update_state(BoardState* st){
 		Piece pc = at(s);
 		st->pawn_key ^= Hashing::psq[side_of(pc)][PAWN][s];
 	}
+	// Material and piece-square scores (do_move() keeps these up to date from here on). //
+	st->psq = SCORE_ZERO;
+	for(Bitboard b = all(); b; ){
+		Square s = pop_lsb(&b);
+		Piece pc = at(s);
+		st->psq += PSQTable[side_of(pc)][type_of(pc)][s];
+	}
+	for(Side c = WHITE; c <= BLACK; c++){
+		st->npm[c] = VAL_ZERO;
+		for(PieceType pt = KNIGHT; pt < KING; pt++){
+			st->npm[c] += pCount[c][pt] * PieceValue[MG][pt];
+		}
+	}
 	// And finally, Zobrist hash for material regardless of location. //
 	for(Side c = WHITE; c <= BLACK; c++){
 		for(PieceType pt = PAWN; pt <= KING; pt++){
@@ -308,6 +359,7 @@ void Board::init_from(const std::string& fen){
 	ss >> st->fifty_ct >> st->ply;
 	st->ply = std::max(st->ply - 1, 0); // starts from 0, fix if bad FEN is given with counter = 0
 	st->fifty_ct = std::max(std::min(st->fifty_ct, 99), 0); // fix halfmove counter
+	st->null_ct = st->fifty_ct;
 	// Update State //
 	update_state(st);
 	st->prev = NULL;
@@ -356,7 +408,55 @@ void Board::init_from(const char* s){
 	init_from(s);
 }
 
-bool Board::is_draw(void) const {
+void Board::init_from(const PackedBoard& pb){
+	clear();
+	for(Side c = WHITE; c <= BLACK; c++){
+		for(PieceType pt = PAWN; pt <= KING; pt++){
+			for(Bitboard b = pb.bySide[c] & pb.byType[pt]; b; ){
+				put_piece(pt, c, pop_lsb(&b));
+			}
+		}
+	}
+	to_move = pb.to_move;
+	update_state(st);
+	st->prev = NULL;
+}
+
+void Board::pack(PackedBoard& pb) const {
+	std::memcpy(pb.bySide, bySide, sizeof(bySide));
+	std::memcpy(pb.byType, byType, sizeof(byType));
+	pb.to_move = to_move;
+}
+
+bool PackedBoard::from_fen(const std::string& fen){
+	// Much cheaper than Board::init_from(), since no stream or state is set up. //
+	std::memset(this, 0, sizeof(PackedBoard));
+	size_t i = 0, idx;
+	int r = RANK_8, f = FILE_A;
+	for(; (i < fen.length()) && (fen[i] != ' '); i++){
+		const char tok = fen[i];
+		if(tok == '/'){
+			if((f != FILE_NB) || (r == RANK_1)) return false;
+			--r;
+			f = FILE_A;
+		} else if((tok >= '1') && (tok <= '8')){
+			f += tok - '0';
+			if(f > FILE_NB) return false;
+		} else if((f < FILE_NB) && ((idx = PieceChar.find(tok)) != std::string::npos)){
+			const Piece p = Piece(idx);
+			const Square s = make_square(Rank(r), File(f++));
+			bySide[side_of(p)] |= s;
+			byType[type_of(p)] |= s;
+		} else return false;
+	}
+	if((r != RANK_1) || (f != FILE_NB)) return false;
+	while((i < fen.length()) && (fen[i] == ' ')) i++;
+	if((i >= fen.length()) || ((fen[i] != 'w') && (fen[i] != 'b'))) return false;
+	to_move = (fen[i] == 'w' ? WHITE : BLACK);
+	return (popcount<Full>(bySide[WHITE] & byType[KING]) == 1) && (popcount<Full>(bySide[BLACK] & byType[KING]) == 1);
+}
+
+bool Board::is_draw(int ply) const {
 	// Fifty-Move Rule //
 	if(st->fifty_ct > 99 && (!checkers() || MoveList<LEGAL>(*this).size())){ 
 		// Note: Using MoveList size is OK since it is unlikely enough that
@@ -364,16 +464,10 @@ bool Board::is_draw(void) const {
 		return true; // drawn by 50-move rule
 	}
 	// Draw by Repetition //
-	BoardState* stp = st; // will be used to store previous states
-	for(int i = 2, e = std::min(st->fifty_ct, st->ply); i <= e; i += 2){
-		// Can only be the exact same during the same person's move, hence
-		// the i += 2 above.
-		if(!stp->prev) break;
-		stp = stp->prev->prev; // find the one 1 full move ago
-		if(!stp) break;
-		if(stp->key == st->key){
-			return true; // Drawn at first repetition
-		}
+	// Note: A repetition after the root is a draw at once, but a position from before the root has to
+	// have been repeated already (do_move() makes the distance negative then).
+	if(st->repetition && (st->repetition < ply)){
+		return true;
 	}
 	// Draw by insufficient material //
 	const Bitboard pcs = all();
@@ -391,6 +485,41 @@ bool Board::is_draw(void) const {
 	return false;
 }
 
+bool Board::has_game_cycle(int ply) const {
+	// Checks if the side to move has a move that gets back to an earlier position (so it //
+	// can at least draw) by looking up the key change in the cuckoo tables.
+	const int end = std::min(st->fifty_ct, st->null_ct);
+	if((end < 3) || !st->prev){
+		return false;
+	}
+	const Key orig_key = st->key;
+	const BoardState* stp = st->prev;
+	for(int i = 3; i <= end; i += 2){
+		if(!stp->prev || !stp->prev->prev) break;
+		stp = stp->prev->prev;
+		const Key move_key = orig_key ^ stp->key;
+		int j;
+		if(((j = H1(move_key)), (cuckoo[j] == move_key)) || ((j = H2(move_key)), (cuckoo[j] == move_key))){
+			const Move move = cuckoo_move[j];
+			const Square s1 = from_sq(move), s2 = to_sq(move);
+			if(!(between_bb(s1, s2) & all())){
+				if(ply > i){
+					return true; // the earlier position comes after the root, so the repetition happens inside the search tree
+				}
+				// Both directions of the move share a slot, so make sure it is our piece that can make it. //
+				if(side_of(at(empty(s1) ? s2 : s1)) != to_move){
+					continue;
+				}
+				// Before the root, it only counts if that position was already a repetition. //
+				if(stp->repetition){
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
 bool Board::legal(Move m, Bitboard pinned) const {
 	// Checks if a given move 'm' is legal. //
 	// Note: Only checks for leaving king in
@@ -422,6 +551,41 @@ bool Board::legal(Move m, Bitboard pinned) const {
 	return (type_of(m) == CASTLING) || !(attackers_to(to, (all() ^ from ^ to)) & pieces(~us)); // castling is already legal when generated
 }
 
+bool Board::pseudo_legal(Move m) const {
+	// Checks if a move that was not generated for this position (such as //
+	// a killer) could have been, so it is safe to pass to legal() and do_move().
+	const Side us = to_move;
+	const Square from = from_sq(m), to = to_sq(m);
+	const Piece pc = moved_piece(m);
+	if(type_of(m) != NORMAL){
+		// These are rare enough that just generating them is fine. //
+		return checkers() ? MoveList<EVASIONS>(*this).contains(m) : MoveList<NON_EVASIONS>(*this).contains(m);
+	}
+	if(promotion_type(m) != KNIGHT) return false; // promotion bits have to be empty for a normal move
+	if((pc == NO_PIECE) || (side_of(pc) != us)) return false; // not our piece
+	if(pieces(us) & to) return false; // can't capture our own piece
+	if(type_of(pc) == PAWN){
+		if(relative_rank(us, to) == RANK_8) return false; // would have to be a promotion
+		if(!(attacks_from<PAWN>(from, us) & pieces(~us) & to) // not a capture
+		   && !((from + pawn_push(us) == to) && empty(to)) // not a single push
+		   && !((from + pawn_push(us) + pawn_push(us) == to) && (relative_rank(us, from) == RANK_2) && empty(to) && empty(to - pawn_push(us)))){ // and not a double push
+			return false;
+		}
+	} else if(!(attacks_from(pc, from) & to)){
+		return false;
+	}
+	if(checkers()){
+		// Evasions are only generated if they can possibly get us out of check. //
+		if(type_of(pc) != KING){
+			if(more_than_one(checkers())) return false; // double check, so only the king can move
+			if(!((between_bb(lsb(checkers()), king_sq(us)) | checkers()) & to)) return false; // doesn't block or capture the checker
+		} else if(attackers_to(to, all() ^ from) & pieces(~us)){
+			return false; // king moves into check
+		}
+	}
+	return true;
+}
+
 bool Board::gives_check(Move m, CheckInfo& ci) const {
 	const Square from = from_sq(m), to = to_sq(m);
 	assert(is_ok(from));
@@ -451,17 +615,21 @@ bool Board::gives_check(Move m, CheckInfo& ci) const {
 }
 
 void Board::do_move(Move m, BoardState& new_st){
+	CheckInfo ci(*this);
+	do_move(m, new_st, gives_check(m, ci));
+}
+
+void Board::do_move(Move m, BoardState& new_st, bool is_checking){
 	assert(is_ok(m));
 	assert(st != &new_st); // or we'll have a problem
-	// Save checking info //
-	CheckInfo ci(*this);
-	bool is_checking = gives_check(m, ci);
 	const Bitboard our_lined = st->lined; // for *our* discover checks
 	// Get the new state set up //
 	Key key = st->key; // save current Zobrist key (so we can modify this, and eventually set the current one to this)
 	const int orig_castling = st->castling; // save original castling rights (so we can XOR it out later and update the castling rights in the hash key)
-	std::memcpy(&new_st, st, sizeof(BoardState));
+	std::memcpy(&new_st, st, offsetof(BoardState, dirty));
 	new_st.prev = st;
+	new_st.dirty.num = 0;
+	new_st.accumulator.net_id = 0;
 	if(new_st.epsq != SQ_NONE){
 		key ^= Hashing::enp[file_of(new_st.epsq)];
 		new_st.epsq = SQ_NONE; // reset e.p. square
@@ -472,6 +640,7 @@ void Board::do_move(Move m, BoardState& new_st){
 	// Increment plies, etc. //
 	++st->ply;
 	++st->fifty_ct;
+	++st->null_ct;
 	key ^= Hashing::side; // we can do this now - it was coming anyway...
 	bool should_reset_50 = false; // if we should set the halfmove counter to 0
 	// Now do the move. //
@@ -483,6 +652,7 @@ void Board::do_move(Move m, BoardState& new_st){
 	assert(side_of(pc) == us && (pCount[WHITE][ALL_PIECES] <= 16) && (pCount[BLACK][ALL_PIECES] <= 16));
 	PieceType pt = type_of(pc);
 	PieceType capd = (type_of(m) != ENPASSANT) ? type_of(at(to)) : PAWN;
+	NNUE::DirtyPiece& dp = st->dirty;
 	if((capd != NO_PIECE_TYPE) && (type_of(m) != CASTLING)){
 		st->capd = capd;
 		Square s = to;
@@ -496,7 +666,12 @@ void Board::do_move(Move m, BoardState& new_st){
 			st->pawn_key ^= Hashing::psq[them][PAWN][s];
 		}
 		remove_piece(capd, them, s);
+		dp.piece[dp.num] = make_piece(them, capd);
+		dp.from[dp.num] = s;
+		dp.to[dp.num++] = SQ_NONE;
 		key ^= Hashing::psq[them][capd][s];
+		st->psq -= PSQTable[them][capd][s];
+		if(capd != PAWN) st->npm[them] -= PieceValue[MG][capd];
 		st->material_key ^= Hashing::psq[them][capd][pCount[them][capd]]; // only pCount[...] instead of that minus 1 since remove_piece() above already decremented it by 1
 	}
 	if((type_of(m) != CASTLING) && st->castling && (capd == ROOK)){
@@ -526,7 +701,11 @@ void Board::do_move(Move m, BoardState& new_st){
 		}
 		// Then, move the piece. //
 		move_piece(pt, us, from, to);
+		dp.piece[dp.num] = pc;
+		dp.from[dp.num] = from;
+		dp.to[dp.num++] = to;
 		key ^= Hashing::psq[us][pt][from] ^ Hashing::psq[us][pt][to]; // moved a piece
+		st->psq += PSQTable[us][pt][to] - PSQTable[us][pt][from];
 		// Now, handle pawn e.p. and halfmove reset //
 		if(pt == PAWN){
 			should_reset_50 = true;
@@ -538,7 +717,11 @@ void Board::do_move(Move m, BoardState& new_st){
 	} else if(type_of(m) == ENPASSANT){
 		// Move our pawn //
 		move_piece(pt, us, from, to);
+		dp.piece[dp.num] = pc;
+		dp.from[dp.num] = from;
+		dp.to[dp.num++] = to;
 		key ^= Hashing::psq[us][PAWN][from] ^ Hashing::psq[us][PAWN][to];
+		st->psq += PSQTable[us][PAWN][to] - PSQTable[us][PAWN][from];
 	} else if(type_of(m) == PROMOTION){
 		// A promotion can be a capture, so handle that. //
 		should_reset_50 = true; // the pawn moved, so we have to reset this
@@ -547,8 +730,16 @@ void Board::do_move(Move m, BoardState& new_st){
 		// And put in the promoted piece. //
 		PieceType prom = promotion_type(m);
 		put_piece(prom, us, to);
+		dp.piece[dp.num] = pc;
+		dp.from[dp.num] = from;
+		dp.to[dp.num++] = SQ_NONE;
+		dp.piece[dp.num] = make_piece(us, prom);
+		dp.from[dp.num] = SQ_NONE;
+		dp.to[dp.num++] = to;
 		key ^= Hashing::psq[us][PAWN][from] ^ Hashing::psq[us][prom][to];
 		st->material_key ^= Hashing::psq[us][PAWN][pCount[us][PAWN]] ^ Hashing::psq[us][prom][pCount[us][prom] - 1]; // the decrementing/incrementing is due to remove/put_piece() already being called above
+		st->psq += PSQTable[us][prom][to] - PSQTable[us][PAWN][from];
+		st->npm[us] += PieceValue[MG][prom];
 	} else if(type_of(m) == CASTLING){
 		assert(pt == KING);
 		if(capd != ROOK){
@@ -568,6 +759,13 @@ void Board::do_move(Move m, BoardState& new_st){
 		key ^= Hashing::psq[us][KING][kfrom] ^ Hashing::psq[us][KING][kto];
 		move_piece(ROOK, us, rfrom, rto);
 		key ^= Hashing::psq[us][ROOK][rfrom] ^ Hashing::psq[us][ROOK][rto];
+		dp.piece[dp.num] = pc;
+		dp.from[dp.num] = kfrom;
+		dp.to[dp.num++] = kto;
+		dp.piece[dp.num] = make_piece(us, ROOK);
+		dp.from[dp.num] = rfrom;
+		dp.to[dp.num++] = rto;
+		st->psq += PSQTable[us][KING][kto] - PSQTable[us][KING][kfrom] + PSQTable[us][ROOK][rto] - PSQTable[us][ROOK][rfrom];
 		// And finish off castling rights. //
 		st->castling &= ~((WHITE_OO | WHITE_OOO) << (2 * us));
 	}
@@ -577,52 +775,78 @@ void Board::do_move(Move m, BoardState& new_st){
 	}
 	// Now, update the checkers, etc. bitboards. //
 	st->checkers = 0;
-	st->pinned = pinned(them);
-	st->lined = lined(them);
 	if(st->castling != orig_castling){
 		key ^= Hashing::castling[orig_castling] ^ Hashing::castling[st->castling];
 	}
 	st->key = key; // update board hash key
-	if(ci.ksq != king_sq(them)){
-		std::cout << *this << Moves::format<false>(m) << std::endl;
-		assert(ci.ksq == king_sq(them));
-	}
 	if(is_checking){
+		const Square ksq = king_sq(them);
 		if(type_of(m) == NORMAL){
 			// We can optimize here. //
-			if(ci.kattk[pt] & to){ // For direct checks
+			if(attacks_from(pc, to) & ksq){ // For direct checks
 				st->checkers |= to;
 			}
-			if(our_lined && (our_lined & from)){ // For discover checks
-				if(pt != ROOK) st->checkers |= attacks_from<ROOK>(ci.ksq) & pieces(us, ROOK, QUEEN); // since rooks can only move in certain ways for discover checks
-				if(pt != BISHOP) st->checkers |= attacks_from<BISHOP>(ci.ksq) & pieces(us, BISHOP, QUEEN); // and same goes for bishops
+			if(our_lined & from){ // For discover checks
+				if(pt != ROOK) st->checkers |= attacks_from<ROOK>(ksq) & pieces(us, ROOK, QUEEN); // since rooks can only move in certain ways for discover checks
+				if(pt != BISHOP) st->checkers |= attacks_from<BISHOP>(ksq) & pieces(us, BISHOP, QUEEN); // and same goes for bishops
 			}
 		} else {
 			// Here we can't do as much optimization. //
-			st->checkers = attackers_to(ci.ksq, byType[ALL_PIECES]) & pieces(us);
+			st->checkers = attackers_to(ksq, byType[ALL_PIECES]) & pieces(us);
 		}
 	}
+	assert(st->checkers == (attackers_to(king_sq(them), byType[ALL_PIECES]) & pieces(us))); // also catches a wrong 'is_checking' from the caller
 	to_move = ~to_move; // flip moving side
+	// Pins and discover check candidates only change when a move is made, so keep them for the new side to move. //
+	st->pinned = check_blockers(to_move, to_move);
+	st->lined = check_blockers(to_move, ~to_move);
 	if(should_reset_50) st->fifty_ct = 0;
-	/*
-	if(st->checkers != (attackers_to(king_sq(them), byType[ALL_PIECES]) & pieces(us))){
-		std::cout << "Move " << Moves::format<false>(m) << " did not have correct checker bitboards updated." << std::endl;
-		std::cout << *this;
-		std::cout << Bitboards::pretty(st->checkers) << std::endl << Bitboards::pretty(attackers_to(king_sq(them), byType[ALL_PIECES]) & pieces(us)) << std::endl;
-		assert(st->checkers == (attackers_to(king_sq(them), byType[ALL_PIECES]) & pieces(us)));
-	}
-	if(attackers_to(king_sq(us), byType[ALL_PIECES]) & pieces(~us)){
-		std::cout << "Move " << Moves::format<false>(m) << " left own king in check and was validated." << std::endl;
-		std::cout << *this;
-		assert(st->prev->checkers);
-		Bitboard chk = st->prev->checkers;
-		while(chk){
-			Square on = pop_lsb(&chk);
-			std::cout << file_char_of(on) << rank_char_of(on) << std::endl;
+	// Repetitions //
+	// Note: Only positions since the last irreversible move (or null move) can repeat, and only every other ply.
+	st->repetition = 0;
+	const int end = std::min(st->fifty_ct, st->null_ct);
+	if(end >= 4){
+		const BoardState* stp = st;
+		for(int i = 2; i <= end; i += 2){
+			if(!stp->prev || !stp->prev->prev) break;
+			stp = stp->prev->prev;
+			if(stp->key == st->key){
+				st->repetition = stp->repetition ? -i : i;
+				break;
+			}
 		}
-		assert(!(attackers_to(king_sq(us), byType[ALL_PIECES]) & pieces(~us))); // make sure we are not left in check
 	}
-	*/
+}
+
+void Board::do_null_move(BoardState& new_st){
+	// A null move only changes the side to move and clears the e.p. square, //
+	// so it doesn't need any of the move-related machinery of do_move().
+	assert(!checkers()); // passing while in check would be illegal
+	assert(st != &new_st);
+	std::memcpy(&new_st, st, offsetof(BoardState, dirty));
+	new_st.prev = st;
+	new_st.dirty.num = 0; // nothing moved, so the accumulator is the same as before
+	new_st.accumulator.net_id = 0;
+	st = &new_st;
+	if(st->epsq != SQ_NONE){
+		st->key ^= Hashing::enp[file_of(st->epsq)];
+		st->epsq = SQ_NONE;
+	}
+	st->key ^= Hashing::side;
+	st->capd = NO_PIECE_TYPE;
+	++st->ply;
+	++st->fifty_ct;
+	st->null_ct = 0;
+	st->repetition = 0;
+	to_move = ~to_move;
+	st->pinned = check_blockers(to_move, to_move);
+	st->lined = check_blockers(to_move, ~to_move);
+}
+
+void Board::undo_null_move(void){
+	assert(!checkers());
+	st = st->prev;
+	to_move = ~to_move;
 }
 
 void Board::undo_move(Move m){
@@ -713,7 +937,7 @@ Value Board::see(Move m) const {
 	assert(is_ok(m));
 	from = from_sq(m);
 	to = to_sq(m);
-	swapList[0] = PieceValue[MG][at(to)]; // the first piece taken
+	swapList[0] = PieceValue[MG][type_of(at(to))]; // the first piece taken
 	stm = side_of(at(from)); // therefore, side to move is side of moving piece
 	occ = all() ^ from; // occupancy is initially without the from square of the first move made
 	if(type_of(m) == CASTLING){
@@ -756,16 +980,51 @@ Value Board::see(Move m) const {
 	return swapList[0]; // everything else gets "condensed" into this final entry
 }
 	
-Value Board::see_sign(Move m) const {
+bool Board::see_ge(Move m, Value threshold) const {
+	// Same exchange as see(), but we only want to know whether the side making the move ends up with at least
+	// threshold, so we keep a running balance instead of a swap list and stop as soon as the answer is known. //
 	assert(is_ok(m));
-	if(PieceValue[MG][type_of(moved_piece(m))] <= PieceValue[MG][type_of(at(to_sq(m)))]){
-		// We are taking a more/equally valuable piece with the same, so:
-		// If we are taking a more valuable piece, then even if the
-		// opponent recaptures, we are good.
-		// If the same, then we will stop there.
-		return VAL_KNOWN_WIN; // hehe
-	}
-	return see(m);
+	if(type_of(m) == CASTLING){
+		return VAL_ZERO >= threshold; // see see() - the rook can never be lost
+	}
+	const Square from = from_sq(m), to = to_sq(m);
+	PieceType capd = type_of(at(from)); // the piece about to be captured next
+	Side stm = ~side_of(at(from)); // the side to recapture
+	Bitboard occ = all() ^ from ^ to;
+	Value balance = PieceValue[MG][type_of(at(to))]; // what we win if the opponent does not recapture
+	if(type_of(m) == ENPASSANT){
+		occ ^= to - pawn_push(~stm); // get rid of the captured pawn
+		balance = PieceValue[MG][PAWN];
+	}
+	if(balance < threshold){
+		return false; // even a free capture is not enough
+	}
+	if(capd == KING){
+		return true; // the move is legal, so the king can never be recaptured
+	}
+	balance -= PieceValue[MG][capd];
+	if(balance >= threshold){
+		return true; // enough even if we lose the moving piece
+	}
+	bool relative_stm = true; // true if the opponent is to move
+	Bitboard attackers = attackers_to(to, occ) & occ, stm_attackers;
+	while(true){
+		stm_attackers = attackers & pieces(stm);
+		if(!stm_attackers){
+			return relative_stm; // no recapture, so the last capture stands
+		}
+		capd = min_attacker<PAWN>(byType, to, stm_attackers, occ, attackers);
+		if(capd == KING){
+			// The king can only recapture if there is nothing left to take it back. //
+			return relative_stm == bool(attackers & pieces(~stm));
+		}
+		balance += relative_stm ? PieceValue[MG][capd] : -PieceValue[MG][capd];
+		relative_stm = !relative_stm;
+		if(relative_stm == (balance >= threshold)){
+			return relative_stm; // the side to move can stand pat here, so nothing after can change the result
+		}
+		stm = ~stm;
+	}
 }
 
 
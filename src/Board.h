@@ -3,8 +3,10 @@
 
 #include "Common.h"
 #include "Bitboards.h"
+#include "NNUE.h"
 
 class Board;
+struct SearchThread;
 
 struct CheckInfo {
 	explicit CheckInfo(const Board& pos);
@@ -18,17 +20,33 @@ struct BoardState {
 	Key material_key; // Zobrist hash key for only material
 	int ply; // fullmove ct but starts from 0
 	int fifty_ct; // halfmove ct
+	int null_ct; // plies since the last null move (repetitions can't go past one)
+	int repetition; // plies back to the same position (0 if none, negative if that one was a repetition too)
 	int castling; // castling rights mask
 	Square epsq; // e.p. square if/a (or SQ_NONE)
+	Score psq; // material + piece-square score (relative to white)
+	Value npm[SIDE_NB]; // non-pawn material by side
 	Bitboard checkers; // everything giving check
 	Bitboard pinned; // pinned pieces
 	Bitboard lined; // everything in line that can give check if a piece is removed
 	BoardState* prev; // previous board state
 	PieceType capd; // captured piece type (for undoing move)
+	// Everything below is not copied by do_move(). //
+	NNUE::DirtyPiece dirty; // pieces changed by the move leading here
+	NNUE::Accumulator accumulator; // network feature transformer output (if computed)
 };
 
 extern const std::string PieceChar;
 
+struct PackedBoard {
+	// A compact position for bulk work: only the pieces and the side to move (no castling rights, e.p. square or counters). //
+	Bitboard bySide[SIDE_NB]; // pieces by side
+	Bitboard byType[PIECE_TYPE_NB]; // pieces by type (ALL_PIECES is not used)
+	Side to_move;
+	
+	bool from_fen(const std::string& fen); // read the placement and side to move (false if malformed or a king is missing)
+};
+
 class Board {
 	private:
 		Side to_move; // side to move
@@ -38,6 +56,7 @@ class Board {
 		int pCount[SIDE_NB][PIECE_TYPE_NB]; // piece-count by side and piece type
 		BoardState orig_st; // original state
 		BoardState* st; // current state
+		SearchThread* thisThread; // the thread searching this board (if/a)
 		
 		void clear(void);
 		Bitboard check_blockers(Side ofC, Side kingC) const; // get pieces of side 'ofC' blocking check on king of side 'kingC'
@@ -57,8 +76,11 @@ class Board {
 		
 		void init_from(const std::string& fen); // init from FEN
 		void init_from(const char* fen); // init from FEN (const char* overload)
+		void init_from(const PackedBoard& pb); // init from a packed position (no castling rights or e.p. square)
+		void pack(PackedBoard& pb) const; // the pieces and side to move
 		std::string fen(void) const; // get FEN
-		bool is_draw(void) const; // check if the position is drawn (aside from stalemate)
+		bool is_draw(int ply) const; // check if the position is drawn (aside from stalemate), 'ply' plies after the search root
+		bool has_game_cycle(int ply) const; // check if a move we have can repeat an earlier position ('ply' plies after the search root)
 		
 		// Pieces //
 		Side side_to_move(void) const; // side to move
@@ -74,6 +96,10 @@ class Board {
 		Square king_sq(Side c) const; // get king square for side
 		Square ep_sq(void) const; // get e.p. square if/a
 		
+		// Material //
+		Score psq_score(void) const; // material + piece-square score (relative to white, kept up to date by do_move())
+		Value non_pawn_material(Side c) const; // non-pawn material of side (kept up to date by do_move())
+		
 		// Castling //
 		int get_castling_rights(void) const; // get castling rights mask
 		void set_castling_rights(CastlingRight cr); // set castling rights
@@ -86,7 +112,7 @@ class Board {
 		// Checking //
 		Bitboard checkers(void) const; // get pieces giving check
 		Bitboard pinned(Side c) const; // get absolutely pinned pieces by side
-		Bitboard lined(Side c) const; // get pieces of *ours* that, if we remove, will give *them* check
+		Bitboard lined(Side c) const; // get pieces of *ours* that, if we remove, will give *them* check (cached in the state)
 		
 		// Attacks //
 		Bitboard attackers_to(Square sq, Bitboard occ) const; // get all attacks to square (side-ind.)
@@ -96,15 +122,19 @@ class Board {
 		
 		// SEE
 		Value see(Move m) const; // SEE a move
-		Value see_sign(Move m) const; // SEE the sign of the move (pos./neg.)
+		bool see_ge(Move m, Value threshold = VAL_ZERO) const; // is the SEE of the move at least threshold?
 		
 		// Moves //
 		Piece moved_piece(Move m) const; // piece moved
 		bool is_capture(Move m) const; // check if move is a capture
 		bool legal(Move m, Bitboard pinned) const; // check if a move is legal
+		bool pseudo_legal(Move m) const; // check if a move (e.g. from the TT or a killer) could have been generated here
 		bool gives_check(Move m, CheckInfo& ci) const; // check if a move gives check
 		void do_move(Move m, BoardState& new_st); // do a move and get a new state (as well as updating current state with prev. link)
+		void do_move(Move m, BoardState& new_st, bool gives_check); // same, but the caller already knows if the move gives check
 		void undo_move(Move m); // undo a move
+		void do_null_move(BoardState& new_st); // pass the move to the other side (only for use in search)
+		void undo_null_move(void); // undo a null move
 		
 		// Hashes //
 		Key key(void) const; // Board hash
@@ -114,6 +144,9 @@ class Board {
 		// Other //
 		int get_ply(void){ return st->ply; }
 		void set_ply(int to){ st->ply = to; }
+		SearchThread* this_thread(void) const { return thisThread; }
+		BoardState* state(void) const { return st; } // current state (the network keeps its accumulator there)
+		void set_thread(SearchThread* th){ thisThread = th; }
 };
 
 inline Side Board::side_to_move(void) const {
@@ -164,6 +197,14 @@ inline Square Board::ep_sq(void) const {
 	return st->epsq;
 }
 
+inline Score Board::psq_score(void) const {
+	return st->psq;
+}
+
+inline Value Board::non_pawn_material(Side c) const {
+	return st->npm[c];
+}
+
 inline int Board::get_castling_rights(void) const {
 	return st->castling;
 }
@@ -185,12 +226,11 @@ inline Bitboard Board::checkers(void) const {
 }
 
 inline Bitboard Board::pinned(Side c) const {
-	// TODO: For 'pinned' and 'lined', consider saving once and returning cached value
-	return check_blockers(to_move, to_move); // pieces of ours pinned against our own king
+	return (c == to_move) ? st->pinned : check_blockers(c, c); // pieces pinned against their own king (only cached for the side to move)
 }
 
 inline Bitboard Board::lined(Side c) const {
-	return check_blockers(c, ~c); // get discovered check candidates AGAINST *their* king
+	return (c == to_move) ? st->lined : check_blockers(c, ~c); // discovered check candidates AGAINST *their* king
 }
 
 template<PieceType Pt>
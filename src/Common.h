@@ -42,6 +42,10 @@
 #include <sys/time.h>
 #include <pthread.h>
 
+#ifdef USE_PEXT
+#	include <immintrin.h> // for _pext_u64 (needs -mbmi2)
+#endif
+
 typedef uint64_t Bitboard;
 typedef uint64_t Key;
 
@@ -147,7 +151,8 @@ enum Depth {
 	DEPTH_MAX = MAX_PLY,
 	DEPTH_QS_CHECKS = 0, // for searching checks
 	DEPTH_QS_NO_CHECKS = -1, // no checks
-	DEPTH_QS_RECAPTURES = -5 // only recaptures
+	DEPTH_QS_RECAPTURES = -5, // only recaptures
+	DEPTH_NONE = -6 // for TT entries with no real depth
 };
 
 enum Square {
@@ -453,6 +458,10 @@ struct HashTable {
 		Entry* operator[](Key key){
 			return &table[(uint32_t)(key) & (Size - 1)]; // cheaper than a modulo instruction
 		}
+		
+		void clear(void){
+			std::fill(table.begin(), table.end(), Entry());
+		}
 };
 
 /* These are different bitcount types depending on use-case. */
@@ -513,6 +522,34 @@ inline int popcount<CNT_HW_POPCNT>(Bitboard b){
 	return __builtin_popcountll(b);
 }
 
+/* And the different ways of indexing the slider attack tables. */
+
+enum SliderIndexType {
+	IDX_MAGIC, // "fancy" magics (multiply and shift)
+	IDX_PEXT // BMI2 parallel bit extract (build with USE_PEXT defined)
+};
+
+#ifdef USE_PEXT
+const SliderIndexType SliderIndex = IDX_PEXT;
+#else
+const SliderIndexType SliderIndex = IDX_MAGIC;
+#endif
+
+template<SliderIndexType> inline unsigned slider_index(Bitboard occupied, Bitboard mask, Bitboard magic, unsigned shift);
+// Note: Like popcount, the specialization is picked at compile time.
+
+template<>
+inline unsigned slider_index<IDX_MAGIC>(Bitboard occupied, Bitboard mask, Bitboard magic, unsigned shift){
+	return unsigned(((occupied & mask) * magic) >> shift);
+}
+
+#ifdef USE_PEXT
+template<>
+inline unsigned slider_index<IDX_PEXT>(Bitboard occupied, Bitboard mask, Bitboard, unsigned){
+	return unsigned(_pext_u64(occupied, mask)); // the bits under the mask, packed together
+}
+#endif
+
 /* Time management functions. */
 
 inline int64_t get_system_time_msec(void){
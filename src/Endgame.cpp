@@ -23,7 +23,7 @@ namespace EndgameN {
 }
 
 void EndgameN::init(void){
-	// TODO: Init KPK tables, etc.
+	Bitbases::init();
 	EndgameN::get_endgames().init();
 }
 
@@ -50,25 +50,31 @@ void Endgames::add(std::string code){
 }
 
 void Endgames::init(void){
-	//add<KPK>("KPK"); // TODO
+	add<KPK>("KPK");
 	//add<KRK>("KRK"); // TODO: fix
 	add<KQK>("KQK");
 }
 
-Value EndgameN::probe(const Board& pos, bool& found){
-	EndgameBase* r = nullptr;
-	r = EndGames.probe(pos.material_key(), r);
-	if(!r){
-		found = false;
-		return VAL_ZERO;
+Square normalize(const Board& pos, Side strong, Square sq){
+	// Maps a square so that the strong side is white and its (only) pawn is on files A-D, as in the bitbase. //
+	if(file_of(lsb(pos.pieces(strong, PAWN))) >= FILE_E){
+		sq = Square(sq ^ 7); // mirror horizontally
 	}
-	found = true;
-	return (*r)(pos);
+	return (strong == WHITE) ? sq : ~sq;
 }
 
 template<>
 Value Endgame<KPK>::operator()(const Board& pos) const {
-	return VAL_ZERO;
+	// The bitbase gives an exact verdict, so all we have to do is make progress (push the pawn) if it is a win. //
+	const Square wksq = normalize(pos, strongSide, pos.king_sq(strongSide));
+	const Square bksq = normalize(pos, strongSide, pos.king_sq(weakSide));
+	const Square psq = normalize(pos, strongSide, lsb(pos.pieces(strongSide, PAWN)));
+	const Side us = (strongSide == pos.side_to_move()) ? WHITE : BLACK;
+	if(!Bitbases::probe_kpk(wksq, psq, bksq, us)){
+		return VAL_DRAW;
+	}
+	const Value ret = VAL_KNOWN_WIN + PawnValueEg + Value(rank_of(psq));
+	return (pos.side_to_move() == strongSide) ? (ret) : (-ret);
 }
 
 template<>
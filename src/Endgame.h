@@ -44,14 +44,21 @@ class Endgames {
 		void init(void);
 		//~Endgames(void);
 		
-		EndgameBase* probe(Key key, EndgameBase* ret){
-			return (ret = (key_map.count(key) ? key_map[key] : NULL));
+		EndgameBase* probe(Key key) const {
+			std::map<Key, EndgameBase*>::const_iterator it = key_map.find(key);
+			return (it != key_map.end()) ? it->second : NULL;
 		}
 };
 
+Key key_for_code(const std::string& code, Side c); // material key for a code like "KRKP" (the first group of pieces belongs to side c)
+
+namespace Bitbases {
+	void init(void); // build the KPK bitbase
+	bool probe_kpk(Square wksq, Square wpsq, Square bksq, Side us); // true if won for the side with the pawn (white, pawn on files A-D, 'us' to move)
+}
+
 namespace EndgameN {
 	void init(void);
-	Value probe(const Board& pos, bool& found);
 	extern Endgames EndGames;
 	
 	inline Endgames& get_endgames(void){
@@ -5,6 +5,10 @@
 #include "Evaluation.h"
 #include "Pawns.h"
 #include "Endgame.h"
+#include "Material.h"
+#include "Threads.h"
+#include "NNUE.h"
+#include <fstream>
 
 #define S(mg, eg) make_score(mg, eg)
 #define SS(g) make_score(g, g)
@@ -13,12 +17,89 @@ enum {
 	Mobility, PawnStructure, PassedPawns, Space, KingSafety
 };
 
-const struct Weight { int mg, eg; } Weights[] = {
+Weight Weights[] = {
 	{289, 344}, {233, 201}, {221, 273}, {46, 0}, {321, 0}
 }; // weights by [above enum from Mobility to KingSafety]
 
 Score PSQTable[SIDE_NB][PIECE_TYPE_NB][SQUARE_NB]; // used for piece-square table scores
 
+Score Eval::PieceSquareTable[][SQUARE_NB] = { // piece-square table scores by [piece type][square]
+	{ },
+	{ // Pawn
+		// For pawns, rook pawns are penalized all the way, while center control (direct
+		// and indirect) is encouraged.
+		S(  0, 0), S( 0, 0), S( 0, 0), S( 0, 0), S(0,  0), S( 0, 0), S( 0, 0), S(  0, 0),
+		S(-20, 0), S( 0, 0), S( 0, 0), S( 0, 0), S(0,  0), S( 0, 0), S( 0, 0), S(-20, 0),
+		S(-20, 0), S( 0, 0), S(10, 0), S(20, 0), S(20, 0), S(10, 0), S( 0, 0), S(-20, 0),
+		S(-20, 0), S( 0, 0), S(20, 0), S(40, 0), S(40, 0), S(20, 0), S( 0, 0), S(-20, 0),
+		S(-20, 0), S( 0, 0), S(10, 0), S(20, 0), S(20, 0), S(10, 0), S( 0, 0), S(-20, 0),
+		S(-20, 0), S( 0, 0), S( 0, 0), S( 0, 0), S(0,  0), S( 0, 0), S( 0, 0), S(-20, 0),
+		S(-20, 0), S( 0, 0), S( 0, 0), S( 0, 0), S(0,  0), S( 0, 0), S( 0, 0), S(-20, 0),
+		S(  0, 0), S( 0, 0), S( 0, 0), S( 0, 0), S(0,  0), S( 0, 0), S( 0, 0), S(  0, 0)
+	},
+	{ // Knight
+		// Standard squares (e.g. from Nf3-style moves) and center occupancy + control is encouraged.
+		// Corners are discouraged, as are back ranks.
+		S(-144,-98), S(-109,-83), S(-85,-51), S(-73,-16), S(-73,-16), S(-85,-51), S(-109,-83), S(-144,-98),
+		S( -88,-68), S( -43,-53), S(-19,-21), S( -7, 14), S( -7, 14), S(-19,-21), S( -43,-53), S( -88,-68),
+		S( -69,-53), S( -24,-38), S(  0, -6), S( 12, 29), S( 12, 29), S(  0, -6), S( -24,-38), S( -69,-53),
+		S( -28,-42), S(  17,-27), S( 41,  5), S( 53, 40), S( 53, 40), S( 41,  5), S(  17,-27), S( -28,-42),
+		S( -30,-42), S(  15,-27), S( 39,  5), S( 51, 40), S( 51, 40), S( 39,  5), S(  15,-27), S( -30,-42),
+		S( -10,-53), S(  35,-38), S( 59, -6), S( 71, 29), S( 71, 29), S( 59, -6), S(  35,-38), S( -10,-53),
+		S( -64,-68), S( -19,-53), S(  5,-21), S( 17, 14), S( 17, 14), S(  5,-21), S( -19,-53), S( -64,-68),
+		S(-200,-98), S( -65,-83), S(-41,-51), S(-29,-16), S(-29,-16), S(-41,-51), S( -65,-83), S(-200,-98)
+	},
+	{ // Bishop
+		// For bishops, the closer to the center, the better in most of the cases.
+		// Back ranks and files are discouraged.
+		S(-54,-65), S(-27,-42), S(-34,-44), S(-43,-26), S(-43,-26), S(-34,-44), S(-27,-42), S(-54,-65),
+		S(-29,-43), S(  8,-20), S(  1,-22), S( -8, -4), S( -8, -4), S(  1,-22), S(  8,-20), S(-29,-43),
+		S(-20,-33), S( 17,-10), S( 10,-12), S(  1,  6), S(  1,  6), S( 10,-12), S( 17,-10), S(-20,-33),
+		S(-19,-35), S( 18,-12), S( 11,-14), S(  2,  4), S(  2,  4), S( 11,-14), S( 18,-12), S(-19,-35),
+		S(-22,-35), S( 15,-12), S(  8,-14), S( -1,  4), S( -1,  4), S(  8,-14), S( 15,-12), S(-22,-35),
+		S(-28,-33), S(  9,-10), S(  2,-12), S( -7,  6), S( -7,  6), S(  2,-12), S(  9,-10), S(-28,-33),
+		S(-32,-43), S(  5,-20), S( -2,-22), S(-11, -4), S(-11, -4), S( -2,-22), S(  5,-20), S(-32,-43),
+		S(-49,-65), S(-22,-42), S(-29,-44), S(-38,-26), S(-38,-26), S(-29,-44), S(-22,-42), S(-49,-65)
+	},
+	{ // Rook
+		// Back ranks + files are discouraged, center control is encouraged.
+		// Does not do much with regards to endgame - TODO.
+		S(-22, 3), S(-17, 3), S(-12, 3), S(-8, 3), S(-8, 3), S(-12, 3), S(-17, 3), S(-22, 3),
+		S(-22, 3), S( -7, 3), S( -2, 3), S( 2, 3), S( 2, 3), S( -2, 3), S( -7, 3), S(-22, 3),
+		S(-22, 3), S( -7, 3), S( -2, 3), S( 2, 3), S( 2, 3), S( -2, 3), S( -7, 3), S(-22, 3),
+		S(-22, 3), S( -7, 3), S( -2, 3), S( 2, 3), S( 2, 3), S( -2, 3), S( -7, 3), S(-22, 3),
+		S(-22, 3), S( -7, 3), S( -2, 3), S( 2, 3), S( 2, 3), S( -2, 3), S( -7, 3), S(-22, 3),
+		S(-22, 3), S( -7, 3), S( -2, 3), S( 2, 3), S( 2, 3), S( -2, 3), S( -7, 3), S(-22, 3),
+		S(-11, 3), S(  4, 3), S(  9, 3), S(13, 3), S(13, 3), S(  9, 3), S(  4, 3), S(-11, 3),
+		S(-22, 3), S(-17, 3), S(-12, 3), S(-8, 3), S(-8, 3), S(-12, 3), S(-17, 3), S(-22, 3)
+	},
+	{ // Queen
+		// Queen is OK at first in most places, but as phase approaches end, back ranks
+		// and files are extremely discouraged, and center control is more encouraged.
+		S(-2,-80), S(-2,-54), S(-2,-42), S(-2,-30), S(-2,-30), S(-2,-42), S(-2,-54), S(-2,-80),
+		S(-2,-54), S( 8,-30), S( 8,-18), S( 8, -6), S( 8, -6), S( 8,-18), S( 8,-30), S(-2,-54),
+		S(-2,-42), S( 8,-18), S( 8, -6), S( 8,  6), S( 8,  6), S( 8, -6), S( 8,-18), S(-2,-42),
+		S(-2,-30), S( 8, -6), S( 8,  6), S( 8, 18), S( 8, 18), S( 8,  6), S( 8, -6), S(-2,-30),
+		S(-2,-30), S( 8, -6), S( 8,  6), S( 8, 18), S( 8, 18), S( 8,  6), S( 8, -6), S(-2,-30),
+		S(-2,-42), S( 8,-18), S( 8, -6), S( 8,  6), S( 8,  6), S( 8, -6), S( 8,-18), S(-2,-42),
+		S(-2,-54), S( 8,-30), S( 8,-18), S( 8, -6), S( 8, -6), S( 8,-18), S( 8,-30), S(-2,-54),
+		S(-2,-80), S(-2,-54), S(-2,-42), S(-2,-30), S(-2,-30), S(-2,-42), S(-2,-54), S(-2,-80)
+	},
+	{ // King
+		// The king attracts enormous bonuses for staying on its back rank, but allows for movement
+		// upwards. All bonuses are scaled down for endgame, and center control becomes much more 
+		// desirable during the endgame. Corners are discouraged during middlegame.
+		S(298, 27), S(332, 81), S(273,108), S(225,116), S(225,116), S(273,108), S(332, 81), S(298, 27),
+		S(287, 74), S(321,128), S(262,155), S(214,163), S(214,163), S(262,155), S(321,128), S(287, 74),
+		S(224,111), S(258,165), S(199,192), S(151,200), S(151,200), S(199,192), S(258,165), S(224,111),
+		S(196,135), S(230,189), S(171,216), S(123,224), S(123,224), S(171,216), S(230,189), S(196,135),
+		S(173,135), S(207,189), S(148,216), S(100,224), S(100,224), S(148,216), S(207,189), S(173,135),
+		S(146,111), S(180,165), S(121,192), S( 73,200), S( 73,200), S(121,192), S(180,165), S(146,111),
+		S(119, 74), S(153,128), S( 94,155), S( 46,163), S( 46,163), S( 94,155), S(153,128), S(119, 74),
+		S( 98, 27), S(132, 81), S( 73,108), S( 25,116), S( 25,116), S( 73,108), S(132, 81), S( 98, 27)
+	}
+};
+
 struct EvalInfo {
 	// This is a structure that collects information computed by evaluation
 	// so effort is not wasted on repeat collections of data.
@@ -32,32 +113,6 @@ struct EvalInfo {
 	Pawns::PawnEntry* pe; // pawn entry from hash table
 };
 
-// Material Imbalance and Values //
-//                            none  pawn knight bishop rook queen
-const int LinearMaterial[6] = { 0, -162, -1122, -183,  249, -154 };
-
-const int QuadraticOurs[][PIECE_TYPE_NB] = {
-	//            OUR PIECES
-	// none pawn knight bishop rook queen
-	{  0                               }, // None
-	{  0,    2                         }, // Pawn
-	{  0,  271,  -4                    }, // Knight      OUR PIECES
-	{  0,  105,   4,    0              }, // Bishop
-	{  0,   -2,  46,   100,  -141      }, // Rook
-	{  0,   25, 129,   142,  -137,   0 }  // Queen
-};
-
-const int QuadraticTheirs[][PIECE_TYPE_NB] = {
-	//           THEIR PIECES
-	// none pawn knight bishop rook queen
-	{   0                               }, // None
-	{   0,    0                         }, // Pawn
-	{   0,   62,   0                    }, // Knight      OUR PIECES
-	{   0,   64,  39,     0             }, // Bishop
-	{   0,   40,  23,   -22,    0       }, // Rook
-	{   0,  105, -39,   141,  274,    0 }  // Queen
-};
-
 // King Safety, Threats //
 const int KingAttackWeights[] = { 0, 0, 6, 2, 5, 5 }; // by [piece type], excl. king, rook == queen
 Score KingDanger[512];
@@ -69,7 +124,7 @@ const Score ThreatenedByPawn[PIECE_TYPE_NB - 1] = {
 // Evaluation Bonuses/Penalties //
 const Score RookOnPawn = S(7, 27); // for rooks picking off pawns
 
-const Score MobilityBonus[][32] = {
+Score MobilityBonus[][32] = {
 	// Mobility Bonus by [piece type][number of available squares]
 	{}, // NO_PIECE_TYPE
 	{}, // Pawns (handled separately)
@@ -154,28 +209,9 @@ void init_eval_info(const Board& pos, EvalInfo& ei){
 	ei.kingAttkWeight[Us] = ei.kingAdjCount[Us] = 0; // zero out the other king safety tables
 }
 
-template<Side Us, bool Verbose>
-int material_imbalance(const int pcount[][SIDE_NB]){
-	const Side Them = (Us == WHITE ? BLACK : WHITE);
-	int bonus = 0;
-	//printf("Side %d.\n", int(Us));
-	for(PieceType i = PAWN; i <= QUEEN; i++){
-		if(!pcount[i][Us]) continue;
-		//printf("Checking piece %c...\n", PieceChar[make_piece(WHITE, i)]);
-		int v = LinearMaterial[i]; // scale factor, or rather, value of this piece type given the current material
-		for(PieceType j = PAWN; j <= QUEEN; j++){
-			//printf("Against %c.\n", PieceChar[make_piece(BLACK, j)]);
-			v += (QuadraticOurs[i][j] * pcount[j][Us]) + (QuadraticTheirs[i][j] * pcount[j][Them]);
-			//printf("V - Now: %d\n", v);
-		}
-		bonus += pcount[i][Us] * v;
-		//printf("Bonus is now %d.\n", bonus);
-	}
-	int16_t cast = int16_t(bonus);
-	return int(cast);
-}
-
-Score psq_score(const Board& pos){
+#ifndef NDEBUG
+bool incremental_material_ok(const Board& pos){
+	// Debug check: recompute the material/piece-square terms do_move() keeps up to date and compare. //
 	Score score = SCORE_ZERO;
 	Bitboard pcs = pos.all();
 	while(pcs){
@@ -183,8 +219,17 @@ Score psq_score(const Board& pos){
 		Piece pc = pos.at(s);
 		score += PSQTable[side_of(pc)][type_of(pc)][s];
 	}
-	return score;
+	if(score != pos.psq_score()) return false;
+	for(Side c = WHITE; c <= BLACK; c++){
+		Value npm = VAL_ZERO;
+		for(PieceType pt = KNIGHT; pt < KING; pt++){
+			npm += pos.count(c, pt) * PieceValue[MG][pt];
+		}
+		if(npm != pos.non_pawn_material(c)) return false;
+	}
+	return true;
 }
+#endif
 
 template<PieceType Pt, Side Us, bool Verbose>
 Score evaluate_pieces(const Board& pos, EvalInfo& ei, Score* mobility, Bitboard* mobility_area){
@@ -377,57 +422,59 @@ Score evaluate_passed_pawns(const Board& pos, EvalInfo& ei){
 	return apply_weight(score, Weights[PassedPawns]);
 }
 
-template<bool Verbose>
-Value do_evaluate(const Board& pos){
+Value blend(const Score score, const Material::Entry* me){
+	// Interpolates b/w the midgame and endgame values by game phase (relative to white). //
+	const ScaleFactor scale_factor = me->scale_factor(eg_value(score) > VAL_ZERO ? WHITE : BLACK); // scale by the side that is ahead
+	const Value v = (mg_value(score) * int(me->game_phase)) + (eg_value(score) * int(PHASE_MIDGAME - me->game_phase) * scale_factor / SCALE_FACTOR_NORMAL);
+	return v / int(PHASE_MIDGAME);
+}
+
+template<bool Verbose, bool Lazy>
+Value do_evaluate(const Board& pos, Value alpha, Value beta, bool& lazy_exit, Pawns::PawnEntry* pe = NULL){
 	// Returns score relative to side to move (e.g. -200 for black to move is +200 for white to move). //
 	// Note: All helper functions should return score relative to white. //
-	// TODO: Material Hash Table
 	Score score = SCORE_ZERO, mobility_score[SIDE_NB] = { SCORE_ZERO, SCORE_ZERO };
-	bool eval_func_found = false;
-	Value pos_score = EndgameN::probe(pos, eval_func_found);
-	if(eval_func_found){
-		return pos_score;
+	lazy_exit = false;
+	// Material //
+	Material::Entry* me = Material::probe(pos);
+	if(me->specialized_eval_exists()){
+		return me->evaluate(pos);
 	}
 	EvalInfo ei;
-	Value nonPawnMaterial[SIDE_NB];
-	Phase game_phase;
-	// Init Eval Info //
-	ei.pe = Pawns::probe(pos);
-	init_eval_info<WHITE>(pos, ei);
-	init_eval_info<BLACK>(pos, ei);
-	ei.attackedBy[WHITE][ALL_PIECES] |= ei.attackedBy[WHITE][KING];
-	ei.attackedBy[BLACK][ALL_PIECES] |= ei.attackedBy[BLACK][KING];
-	for(Side c = WHITE; c <= BLACK; c++){
-		nonPawnMaterial[c] = Value(0);
-		for(PieceType pt = KNIGHT; pt < KING; pt++){
-			nonPawnMaterial[c] += (pos.count(c, pt) * PieceValue[MG][pt]);
+	const Phase game_phase = me->game_phase;
+	ei.pe = pe ? pe : Pawns::probe(pos); // the batch evaluation fills in its pawn entries beforehand
+	assert(incremental_material_ok(pos));
+	if(Verbose){
+		for(Side c = WHITE; c <= BLACK; c++){
+			printf("side %d: %d\n", int(c), int(pos.non_pawn_material(c)));
 		}
-		if(Verbose) printf("side %d: %d\n", int(c), int(nonPawnMaterial[c]));
+		printf("Game phase: %d\n", game_phase);
 	}
-	Value total_npm = nonPawnMaterial[BLACK] + nonPawnMaterial[WHITE];
-	total_npm = std::max(EndgameLimit, std::min(MidgameLimit, total_npm));
-	game_phase = Phase(((total_npm - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit)); // scale phase b/w midgame and endgame, truncate decimal point
-	if(Verbose) printf("Game phase: %d\n", game_phase);
 	// TODO: Space evaluation
 	// TODO: Threats, etc.
 	// Material Factoring //
-	const int pcounts[PIECE_TYPE_NB - 1][SIDE_NB] = {
-		{}, // NO_PIECE_TYPE
-		{ pos.count(WHITE, PAWN), pos.count(BLACK, PAWN) },
-		{ pos.count(WHITE, KNIGHT), pos.count(BLACK, KNIGHT) },
-		{ pos.count(WHITE, BISHOP), pos.count(BLACK, BISHOP) },
-		{ pos.count(WHITE, ROOK), pos.count(BLACK, ROOK) },
-		{ pos.count(WHITE, QUEEN), pos.count(BLACK, QUEEN) }
-	};
-	Value imb = Value((material_imbalance<WHITE, Verbose>(pcounts) - material_imbalance<BLACK, Verbose>(pcounts)) / 16);
-	score += SS(imb);
-	if(Verbose) printf("Material Imbalance: %d\n", imb);
+	score += me->imbalance();
+	if(Verbose) printf("Material Imbalance: %d\n", mg_value(me->imbalance()));
 	// Piece-Square Tables //
-	score += psq_score(pos); // piece-square tables
+	score += pos.psq_score(); // piece-square tables (kept up to date by do_move())
 	if(Verbose) printf("+PSQT Score: %s\n", score_str(score).c_str());
 	// Pawns //
 	score += apply_weight(ei.pe->pawn_score(), Weights[PawnStructure]);
 	if(Verbose) printf("+Pawns Score: %s\n", score_str(score).c_str());
+	// Lazy Exit //
+	// If material, PSQ and pawns alone are far outside the window, the rest won't bring it back. //
+	if(Lazy){
+		const Value v = (pos.side_to_move() == WHITE) ? blend(score, me) : -blend(score, me);
+		if((v > beta + Eval::LazyMargin) || (v < alpha - Eval::LazyMargin)){
+			lazy_exit = true;
+			return v;
+		}
+	}
+	// Init Eval Info //
+	init_eval_info<WHITE>(pos, ei);
+	init_eval_info<BLACK>(pos, ei);
+	ei.attackedBy[WHITE][ALL_PIECES] |= ei.attackedBy[WHITE][KING];
+	ei.attackedBy[BLACK][ALL_PIECES] |= ei.attackedBy[BLACK][KING];
 	// Piece-Specific Evaluation and Mobility //
 	Bitboard mobility_area[SIDE_NB] = { ~(ei.attackedBy[BLACK][PAWN] | pos.pieces(WHITE, PAWN, KING)), ~(ei.attackedBy[WHITE][PAWN] | pos.pieces(BLACK, PAWN, KING)) }; // what we are considering as "mobile" squares
 	score += evaluate_pieces<KNIGHT, WHITE, Verbose>(pos, ei, mobility_score, mobility_area);
@@ -441,22 +488,154 @@ Value do_evaluate(const Board& pos){
 	score += evaluate_passed_pawns<WHITE, Verbose>(pos, ei) - evaluate_passed_pawns<BLACK, Verbose>(pos, ei);
 	if(Verbose) printf("+Passed Pawns: %s\n", score_str(score).c_str());
 	// Return //
-	// TODO: ScaleFactor's and specialized evaluation functions
-	ScaleFactor scale_factor = SCALE_FACTOR_NORMAL; // TODO
-	Value final_score = (mg_value(score) * int(game_phase)) + (eg_value(score) * int(PHASE_MIDGAME - game_phase) * scale_factor / SCALE_FACTOR_NORMAL);
-	final_score /= int(PHASE_MIDGAME);
+	const Value final_score = blend(score, me);
 	if(Verbose) printf("Final score: %d\n", final_score);
 	// TODO: Tempo
 	assert(abs(final_score) < VAL_INF);
 	return (pos.side_to_move() == WHITE) ? (final_score) : (-final_score);
 }
 
+size_t Eval::CacheSize = Eval::EvalCache::DefaultSize;
+Value Eval::LazyMargin = Value(Eval::DefaultLazyMargin);
+
+void Eval::EvalCache::resize(size_t mbSize){
+	const size_t count = mbSize ? (size_t(1) << msb((mbSize * 1024 * 1024) / sizeof(uint64_t))) : 0;
+	std::vector<uint64_t>(count, 0).swap(table); // actually give back the memory when shrinking
+	mask = count ? (count - 1) : 0;
+	hits = probes = 0;
+}
+
+void Eval::EvalCache::clear(void){
+	std::fill(table.begin(), table.end(), 0);
+}
+
+template<bool Lazy>
+Value evaluate_with(const Board& pos, Value alpha, Value beta, bool& lazy_exit){
+	// Picks the evaluator: the network (if enabled) replaces everything but the specialized endgames. //
+	if(NNUE::Enabled){
+		lazy_exit = false;
+		Material::Entry* me = Material::probe(pos);
+		return me->specialized_eval_exists() ? me->evaluate(pos) : NNUE::evaluate(pos);
+	}
+	return do_evaluate<false, Lazy>(pos, alpha, beta, lazy_exit);
+}
+
 Value Eval::evaluate(const Board& pos){
-	return do_evaluate<false>(pos);
+	bool lazy_exit;
+	SearchThread* th = pos.this_thread();
+	if(!th || !th->eval_cache.enabled()){
+		return evaluate_with<false>(pos, -VAL_INF, VAL_INF, lazy_exit);
+	}
+	Value v;
+	if(!th->eval_cache.probe(pos.key(), v)){
+		v = evaluate_with<false>(pos, -VAL_INF, VAL_INF, lazy_exit);
+		th->eval_cache.store(pos.key(), v);
+	}
+	return v;
+}
+
+Value Eval::evaluate(const Board& pos, Value alpha, Value beta, bool& lazy_exit){
+	SearchThread* th = pos.this_thread();
+	Value v;
+	lazy_exit = false;
+	if(th && th->eval_cache.enabled() && th->eval_cache.probe(pos.key(), v)){
+		return v; // an exact value is better than a lazy one
+	}
+	if(!LazyMargin || NNUE::Enabled){
+		v = evaluate_with<false>(pos, alpha, beta, lazy_exit);
+	} else {
+		v = evaluate_with<true>(pos, alpha, beta, lazy_exit);
+		if(th){
+			++th->lazy_tries;
+			th->lazy_exits += lazy_exit;
+		}
+	}
+	if(th && th->eval_cache.enabled() && !lazy_exit){
+		th->eval_cache.store(pos.key(), v); // never cache a lazy value
+	}
+	return v;
 }
 
 Value Eval::evaluate_verbose(const Board& pos){
-	return do_evaluate<true>(pos);
+	bool lazy_exit;
+	const Value v = do_evaluate<true, false>(pos, -VAL_INF, VAL_INF, lazy_exit);
+	if(NNUE::loaded()){
+		printf("Network: %d\n", NNUE::evaluate(pos));
+	}
+	return v;
+}
+
+void Eval::evaluate_batch(const PackedBoard* positions, size_t n, Value* out, SearchThread* th){
+	Board pos;
+	bool lazy_exit;
+	Pawns::PawnEntry entries[BatchSize];
+	for(size_t base = 0; base < n; base += BatchSize){
+		const size_t k = std::min(n - base, size_t(BatchSize));
+		if(!NNUE::Enabled){
+			Pawns::evaluate_batch(positions + base, k, entries); // the whole block at once (a pawn hash would only miss here)
+		}
+		for(size_t i = 0; i < k; i++){
+			pos.init_from(positions[base + i]);
+			pos.set_thread(th);
+			out[base + i] = NNUE::Enabled ? evaluate_with<false>(pos, -VAL_INF, VAL_INF, lazy_exit)
+				: do_evaluate<false, false>(pos, -VAL_INF, VAL_INF, lazy_exit, &entries[i]);
+		}
+	}
+}
+
+void Eval::evaluate_file(std::string fname, std::string outf){
+	// Each line is a FEN, optionally followed by EPD operations (";..."), which are ignored. //
+	const size_t ChunkSize = 65536; // positions read and evaluated at a time
+	std::ifstream ifp(fname);
+	if(!ifp.is_open()){
+		Error("Could not open EPD file '" + fname + "' for reading.");
+	}
+	std::ofstream ofp;
+	if(outf.length()){
+		ofp.open(outf);
+		if(!ofp.is_open()){
+			Error("Could not open output file '" + outf + "' for writing.");
+		}
+	}
+	std::vector<std::string> fens;
+	std::vector<PackedBoard> packed;
+	std::vector<Value> values;
+	std::string line;
+	uint64_t total = 0, skipped = 0;
+	int64_t parse_time = 0, eval_time = 0;
+	bool more = true;
+	while(more){
+		fens.clear();
+		packed.clear();
+		int64_t start = get_system_time_msec();
+		while((packed.size() < ChunkSize) && (more = bool(std::getline(ifp, line)))){
+			std::string fen = line.substr(0, line.find(';'));
+			while(!fen.empty() && isspace(fen.back())) fen.pop_back();
+			if(fen.empty() || (fen[0] == '#')) continue; // blank line or comment
+			PackedBoard pb;
+			if(!pb.from_fen(fen)){
+				++skipped;
+				continue;
+			}
+			packed.push_back(pb);
+			if(ofp.is_open()) fens.push_back(fen);
+		}
+		parse_time += get_system_time_msec() - start;
+		values.resize(packed.size());
+		start = get_system_time_msec();
+		evaluate_batch(packed.data(), packed.size(), values.data());
+		eval_time += get_system_time_msec() - start;
+		total += packed.size();
+		for(size_t i = 0; i < fens.size(); i++){
+			ofp << fens[i] << " ; ce " << (values[i] * 100 / PawnValueEg) << "\n";
+		}
+	}
+	if(skipped){
+		Warn(std::to_string(skipped) + " malformed line(s) skipped.");
+	}
+	printf("%" PRIu64 " position(s) evaluated\n", total);
+	printf("Parsing: %" PRId64 " ms, evaluation: %" PRId64 " ms, %" PRIu64 " positions/s (%" PRIu64 " including parsing)\n", parse_time, eval_time,
+		(total * 1000) / uint64_t(std::max(eval_time, int64_t(1))), (total * 1000) / uint64_t(std::max(parse_time + eval_time, int64_t(1))));
 }
 
 
@@ -17,6 +17,11 @@
 #include "Annotate.h"
 #include "PGN.h"
 #include "Book.h"
+#include "TT.h"
+#include "Perft.h"
+#include "Tablebase.h"
+#include "NNUE.h"
+#include "Tune.h"
 #include <sstream>
 #include <fstream>
 
@@ -75,6 +80,7 @@ void InitCrit(void){
 	Pawns::init();
 	Search::init();
 	Threads.init();
+	TT.resize(TranspositionTable::DefaultSize);
 	EndgameN::init();
 	// Not critical, per se, but useful.
 	PGN::init();
@@ -95,6 +101,15 @@ void InitCrit(void){
 		puts("\t-annotate FNAME\tAnnotate the given PGN game file (use -out ONAME to specify output file, -anntime To specify time per move for annotation)");
 		puts("\t-read FNAME\tRead the specified PGN game file (use -create ONAME to create a book from the file)");
 		puts("\t-readbook FNAME\tRead the specified book file and launch an interactive console");
+		puts("\t-perft DEPTH\tCount the leaf nodes from the start position (use -fen FEN for another position, -divide to show the count for each move)");
+		puts("\t-perftsuite FNAME\tRun an EPD perft suite such as data/perft.epd (use -perftdepth N to limit the depth, 5 by default)");
+		puts("\t\t\tBoth perft modes take -threads N and -perfthash MB (0 turns the hash off)");
+		puts("\t-gentb [MEN]\tGenerate the missing endgame tablebases with up to MEN pieces (4 by default, at most 5)");
+		puts("\t\t\tUse -tbpath DIR for the output directory (tb by default), -tbonly CODE (e.g. KRKP) for one table and what it converts into, and -threads N");
+		puts("\t-evalbatch FNAME\tStatically evaluate every position of an EPD file and report positions/s");
+		puts("\t\t\tUse -out ONAME to write each FEN with its score (\"; ce <centipawns>\"), -evalfile NET to evaluate with a network");
+		puts("\t-tune [DIR]\tTune the evaluation tables on the quiet positions of DIR/*.pgn (data by default) and write them as C++");
+		puts("\t\t\tUse -out ONAME for the output file, -tuneepochs N (100 by default), -tunerate R (1.0 by default), -tunelimit N to use at most N positions, and -threads N (all cores by default)");
 	} else if(args.contains("-ics")){
 		Book::init();
 		// ICS (if/a) //
@@ -297,6 +312,74 @@ void InitCrit(void){
 				}
 			}
 		}
+	} else if(args.contains("-perft") || args.contains("-perftsuite")){
+		Perft_Options op;
+		op.threads = args.contains("-threads") ? std::max(atoi(args.value("-threads").c_str()), 1) : 1;
+		op.hash = args.contains("-perfthash") ? std::max(atoi(args.value("-perfthash").c_str()), 0) : PerftTable::DefaultSize;
+		op.divide = args.contains("-divide");
+		if(args.contains("-perftsuite")){
+			const std::string inf = args.value("-perftsuite");
+			if(!inf.length()){
+				Error("Option '-perftsuite' requires an input filename.");
+			}
+			const int max_depth = args.contains("-perftdepth") ? atoi(args.value("-perftdepth").c_str()) : 5;
+			op.divide = false; // far too much output for a whole suite
+			return Perft::run_suite(inf, Depth(max_depth), op) ? 0 : 1;
+		}
+		const int depth = atoi(args.value("-perft").c_str());
+		if(depth < 1){
+			Error("Option '-perft' requires a depth of at least 1.");
+		}
+		Board pos;
+		pos.init_from(args.contains("-fen") ? args.value("-fen") : StartFEN);
+		PerftTable ptt;
+		ptt.resize(op.hash);
+		const int64_t start = get_system_time_msec();
+		const uint64_t nodes = Perft::run(pos, Depth(depth), op, ptt);
+		const int64_t elapsed = std::max(get_system_time_msec() - start, int64_t(1));
+		printf("\nNodes: %" PRIu64 ", time: %" PRId64 " ms, %" PRIu64 " nodes/s\n", nodes, elapsed, (nodes * 1000) / uint64_t(elapsed));
+	} else if(args.contains("-gentb")){
+		TB_Options op;
+		op.threads = args.contains("-threads") ? std::max(atoi(args.value("-threads").c_str()), 1) : 1;
+		const std::string men = args.value("-gentb");
+		op.max_men = (men.length() && isdigit(men[0])) ? atoi(men.c_str()) : 4;
+		op.path = args.contains("-tbpath") ? args.value("-tbpath") : "tb";
+		op.only = args.contains("-tbonly") ? args.value("-tbonly") : "";
+		if((op.max_men < 3) || (op.max_men > Tablebases::MaxMen)){
+			Error("Option '-gentb' takes a piece count from 3 to " + std::to_string(Tablebases::MaxMen) + ".");
+		}
+		return Tablebases::generate(op) ? 0 : 1;
+	} else if(args.contains("-evalbatch")){
+		const std::string inf = args.value("-evalbatch");
+		if(!inf.length()){
+			Error("Option '-evalbatch' requires an input filename.");
+		}
+		if(args.contains("-evalfile")){
+			if(!NNUE::load(args.value("-evalfile"))){
+				Error("Could not load the network '" + args.value("-evalfile") + "'.");
+			}
+			NNUE::Enabled = true;
+		}
+		Eval::evaluate_file(inf, args.value("-out"));
+	} else if(args.contains("-tune")){
+		Tune_Options op;
+		const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		op.threads = args.contains("-threads") ? std::max(atoi(args.value("-threads").c_str()), 1) : size_t(std::max(cores, 1L));
+		op.epochs = args.contains("-tuneepochs") ? std::max(atoi(args.value("-tuneepochs").c_str()), 0) : 100;
+		op.rate = args.contains("-tunerate") ? atof(args.value("-tunerate").c_str()) : 1.0;
+		op.max_positions = args.contains("-tunelimit") ? size_t(std::max(atoll(args.value("-tunelimit").c_str()), 0LL)) : 0;
+		const std::string dir = args.value("-tune");
+		op.path = (dir.length() && (dir[0] != '-')) ? dir : "data";
+		op.out = "tuned.cpp";
+		if(!args.contains("-out")){
+			Warn("No output file given, assuming '" + op.out + "'.");
+		} else {
+			op.out = args.value("-out");
+		}
+		if(op.rate <= 0.0){
+			Error("Option '-tunerate' requires a positive rate.");
+		}
+		return Tune::run(op) ? 0 : 1;
 	} else {
 		Book::init();
 		// Start the UCI Loop //
@@ -0,0 +1,90 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+#include "Evaluation.h"
+#include "Endgame.h"
+#include "Material.h"
+#include "Threads.h"
+
+Material::MaterialTable MaterialHashTable; // for positions not being searched by a thread
+
+// Material Imbalance and Values //
+//                            none  pawn knight bishop rook queen
+const int LinearMaterial[6] = { 0, -162, -1122, -183,  249, -154 };
+
+int QuadraticOurs[][PIECE_TYPE_NB] = {
+	//            OUR PIECES
+	// none pawn knight bishop rook queen
+	{  0                               }, // None
+	{  0,    2                         }, // Pawn
+	{  0,  271,  -4                    }, // Knight      OUR PIECES
+	{  0,  105,   4,    0              }, // Bishop
+	{  0,   -2,  46,   100,  -141      }, // Rook
+	{  0,   25, 129,   142,  -137,   0 }  // Queen
+};
+
+int QuadraticTheirs[][PIECE_TYPE_NB] = {
+	//           THEIR PIECES
+	// none pawn knight bishop rook queen
+	{   0                               }, // None
+	{   0,    0                         }, // Pawn
+	{   0,   62,   0                    }, // Knight      OUR PIECES
+	{   0,   64,  39,     0             }, // Bishop
+	{   0,   40,  23,   -22,    0       }, // Rook
+	{   0,  105, -39,   141,  274,    0 }  // Queen
+};
+
+template<Side Us>
+int material_imbalance(const int pcount[][SIDE_NB]){
+	const Side Them = (Us == WHITE ? BLACK : WHITE);
+	int bonus = 0;
+	for(PieceType i = PAWN; i <= QUEEN; i++){
+		if(!pcount[i][Us]) continue;
+		int v = LinearMaterial[i]; // scale factor, or rather, value of this piece type given the current material
+		for(PieceType j = PAWN; j <= QUEEN; j++){
+			v += (QuadraticOurs[i][j] * pcount[j][Us]) + (QuadraticTheirs[i][j] * pcount[j][Them]);
+		}
+		bonus += pcount[i][Us] * v;
+	}
+	int16_t cast = int16_t(bonus);
+	return int(cast);
+}
+
+Material::Entry* Material::probe(const Board& pos){
+	Key key = pos.material_key();
+	SearchThread* th = pos.this_thread();
+	Material::Entry* e = (th ? th->material_table[key] : MaterialHashTable[key]);
+	if(e->key == key) return e;
+	std::memset(e, 0, sizeof(Entry));
+	e->key = key;
+	e->factor[WHITE] = e->factor[BLACK] = uint8_t(SCALE_FACTOR_NORMAL);
+	// Game Phase //
+	const Value npm[SIDE_NB] = { pos.non_pawn_material(WHITE), pos.non_pawn_material(BLACK) };
+	const Value total_npm = std::max(EndgameLimit, std::min(MidgameLimit, npm[WHITE] + npm[BLACK]));
+	e->game_phase = Phase(((total_npm - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit)); // scale phase b/w midgame and endgame, truncate decimal point
+	// Specialized Evaluation //
+	// Note: This is the only time we have to look in the endgame map for this material configuration.
+	if((e->evaluation_function = EndgameN::get_endgames().probe(key)) != NULL){
+		return e;
+	}
+	// Scale Factors //
+	for(Side c = WHITE; c <= BLACK; c++){
+		if(npm[c] - npm[~c] > BishopValueMg) continue; // a minor piece or less ahead is hard to convert without pawns
+		if(!pos.count(c, PAWN)){
+			e->factor[c] = uint8_t(npm[c] < RookValueMg ? SCALE_FACTOR_DRAW : (npm[~c] <= BishopValueMg ? 4 : 14));
+		} else if(pos.count(c, PAWN) == 1){
+			e->factor[c] = uint8_t(SCALE_FACTOR_ONEPAWN);
+		}
+	}
+	// Material Imbalance //
+	const int pcounts[PIECE_TYPE_NB - 1][SIDE_NB] = {
+		{}, // NO_PIECE_TYPE
+		{ pos.count(WHITE, PAWN), pos.count(BLACK, PAWN) },
+		{ pos.count(WHITE, KNIGHT), pos.count(BLACK, KNIGHT) },
+		{ pos.count(WHITE, BISHOP), pos.count(BLACK, BISHOP) },
+		{ pos.count(WHITE, ROOK), pos.count(BLACK, ROOK) },
+		{ pos.count(WHITE, QUEEN), pos.count(BLACK, QUEEN) }
+	};
+	e->value = int16_t((material_imbalance<WHITE>(pcounts) - material_imbalance<BLACK>(pcounts)) / 16);
+	return e;
+}
@@ -0,0 +1,43 @@
+#ifndef MATERIAL_INCLUDED
+#define MATERIAL_INCLUDED
+
+#include "Common.h"
+#include "Board.h"
+#include "Endgame.h"
+
+// Tables that '-tune' adjusts (see Tune.h) //
+extern int QuadraticOurs[][PIECE_TYPE_NB]; // imbalance by [our piece type][our piece type]
+extern int QuadraticTheirs[][PIECE_TYPE_NB]; // imbalance by [our piece type][their piece type]
+
+namespace Material {
+	struct Entry {
+		// This contains information about a material configuration (everything here only depends on the material key). //
+		Key key; // no hash collisions allowed
+		int16_t value; // material imbalance (relative to white)
+		uint8_t factor[SIDE_NB]; // endgame scale factors by side (used when that side is ahead)
+		Phase game_phase; // scaled b/w PHASE_ENDGAME and PHASE_MIDGAME from the non-pawn material
+		EndgameBase* evaluation_function; // specialized evaluation function (if/a)
+
+		Score imbalance(void) const {
+			return make_score(value, value);
+		}
+
+		bool specialized_eval_exists(void) const {
+			return evaluation_function != NULL;
+		}
+
+		Value evaluate(const Board& pos) const {
+			return (*evaluation_function)(pos);
+		}
+
+		ScaleFactor scale_factor(Side c) const {
+			return ScaleFactor(factor[c]);
+		}
+	};
+
+	typedef HashTable<Entry, 8192> MaterialTable;
+
+	Entry* probe(const Board& pos);
+}
+
+#endif // #ifndef MATERIAL_INCLUDED
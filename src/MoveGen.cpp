@@ -287,8 +287,28 @@ Move Moves::parse<true>(std::string move, const Board& pos){
 // inline Move make_move(Square from, Square to)
 // template<MoveType T> inline Move make(Square from, Square to, PieceType pt = KNIGHT)
 
-template<GenType T>
-ActMove* generate_sliders_knight(const Board& pos, ActMove* list, Side us){
+struct LegalMasks {
+	// Worked out once per call so the legal generators never have to undo a move. //
+	Square ksq; // our king
+	Bitboard pinned; // our pieces pinned to our king (they can only move along the pin ray)
+	Bitboard target; // squares a non-king move has to land on (all of them, or the block/capture squares when in check)
+};
+
+Bitboard king_danger(const Board& pos, Side us){
+	// Everything they attack with our king taken off the board, so it can't step back along a slider's ray. //
+	const Side them = ~us;
+	const Bitboard occ = pos.all() ^ pos.pieces(us, KING);
+	Bitboard danger = pos.attacks_from<KING>(pos.king_sq(them));
+	const Bitboard pawns = pos.pieces(them, PAWN);
+	danger |= (them == WHITE) ? (shift_bb<DELTA_NE>(pawns) | shift_bb<DELTA_NW>(pawns)) : (shift_bb<DELTA_SE>(pawns) | shift_bb<DELTA_SW>(pawns));
+	for(Bitboard b = pos.pieces(them, KNIGHT); b; ) danger |= pos.attacks_from<KNIGHT>(pop_lsb(&b));
+	for(Bitboard b = pos.pieces(them, BISHOP, QUEEN); b; ) danger |= attacks_bb<BISHOP>(pop_lsb(&b), occ);
+	for(Bitboard b = pos.pieces(them, ROOK, QUEEN); b; ) danger |= attacks_bb<ROOK>(pop_lsb(&b), occ);
+	return danger;
+}
+
+template<GenType T, bool Legal>
+ActMove* generate_sliders_knight(const Board& pos, ActMove* list, Side us, const LegalMasks& lm){
 	// This generates all slider moves and knight moves as specified by GenType. //
 	Bitboard attks[PIECE_TYPE_NB - 1];
 	if(T == QUIET_CHECKS){
@@ -314,6 +334,10 @@ ActMove* generate_sliders_knight(const Board& pos, ActMove* list, Side us){
 		} else if(T == QUIET_CHECKS){
 			possibs &= attks[pt]; // only the squares that it gives check on
 		}
+		if(Legal){
+			possibs &= lm.target;
+			if(lm.pinned & from) possibs &= LineBB[lm.ksq][from]; // a knight never stays on the line, so a pinned one gets nothing
+		}
 		while(possibs){
 			Square to = pop_lsb(&possibs);
 			if((T != EVASIONS) || (to == chksq) || (between_bb(ksq, chksq) & to)){
@@ -324,7 +348,7 @@ ActMove* generate_sliders_knight(const Board& pos, ActMove* list, Side us){
 	return list;
 }
 
-template<GenType T>
+template<GenType T, bool Legal>
 ActMove* generate_king(const Board& pos, ActMove* list, Side us){
 	// This generates all king moves (other than castling). //
 	assert(T != QUIET_CHECKS);
@@ -340,6 +364,9 @@ ActMove* generate_king(const Board& pos, ActMove* list, Side us){
 	} else if(T == NON_CAPTURES){
 		possibs &= ~pos.all(); // no captures, period
 	}
+	if(Legal && possibs){
+		possibs &= ~king_danger(pos, us);
+	}
 	while(possibs){
 		Square to = pop_lsb(&possibs);
 		(list++)->move = make_move(from, to);
@@ -376,8 +403,8 @@ ActMove* generate_castles(const Board& pos, ActMove* list, Side us){
 	return list;
 }
 
-template<GenType T>
-ActMove* generate_pawns(const Board& pos, ActMove* list, Side us){
+template<GenType T, bool Legal>
+ActMove* generate_pawns(const Board& pos, ActMove* list, Side us, const LegalMasks& lm){
 	// This generates all pawn moves and knight moves as specified by GenType. //
 	// Note: There should not be a double-check.
 	Bitboard pcs = pos.pieces(us, PAWN);
@@ -407,6 +434,10 @@ ActMove* generate_pawns(const Board& pos, ActMove* list, Side us){
 			possibs &= pos.attacks_from<PAWN>(tksq, ~us) | (pos.attacks_from<KNIGHT>(tksq) & rank_bb(relative_rank(us, RANK_8))); // have to give them check (via direct or knight underpromotion)
 			possibs &= ~pos.all(); // *quiet* checks
 		}
+		if(Legal){
+			possibs &= lm.target | ep_mask; // e.p. can take the checker without landing on it, so it is checked below
+			if(lm.pinned & from) possibs &= LineBB[lm.ksq][from];
+		}
 		// And, fill up the move list. //
 		while(possibs){
 			Square to = pop_lsb(&possibs);
@@ -422,7 +453,11 @@ ActMove* generate_pawns(const Board& pos, ActMove* list, Side us){
 							std::cout << "Rank: " << int(relative_rank(us, to)) << std::endl;
 							assert(relative_rank(us, to) == RANK_6);
 						}
-						(list++)->move = make<ENPASSANT>(from, to);
+						const Move m = make<ENPASSANT>(from, to);
+						// Taking both pawns off the rank can uncover a check no pin mask sees, so leave that to legal(). //
+						if(!Legal || ((lm.target & (SquareBB[to] | to_cap)) && pos.legal(m, lm.pinned))){
+							(list++)->move = m;
+						}
 					}
 				} else {
 					// OK, it looks like we got a pawn promoted!
@@ -438,86 +473,66 @@ ActMove* generate_pawns(const Board& pos, ActMove* list, Side us){
 	return list;
 }
 
-template<GenType T> ActMove* generate_evasions(const Board& pos, ActMove* list, Side us);
-
-template<>
-ActMove* generate_evasions<EVASIONS>(const Board& pos, ActMove* list, Side us){
+template<bool Legal>
+ActMove* generate_evasions(const Board& pos, ActMove* list, Side us, const LegalMasks& lm){
 	const Bitboard chk = pos.checkers();
 	if(more_than_one(chk)){
 		// Double check - king *has* to move
-		list = generate_king<EVASIONS>(pos, list, us);
+		list = generate_king<EVASIONS, Legal>(pos, list, us);
 		return list;
 	}
-	list = generate_sliders_knight<EVASIONS>(pos, list, us);
-	list = generate_king<EVASIONS>(pos, list, us);
-	list = generate_pawns<EVASIONS>(pos, list, us);
+	list = generate_sliders_knight<EVASIONS, Legal>(pos, list, us, lm);
+	list = generate_king<EVASIONS, Legal>(pos, list, us);
+	list = generate_pawns<EVASIONS, Legal>(pos, list, us, lm);
 	// Castles are not allowed under check anyway.
 	return list;
 }
-	
-
-// TODO: Perft, evasions, captures, quiets, etc.
-
-template<>
-ActMove* generate_moves<NON_EVASIONS>(const Board& pos, ActMove* list){
-	Side us = pos.side_to_move();
-	list = generate_sliders_knight<NON_EVASIONS>(pos, list, us);
-	list = generate_king<NON_EVASIONS>(pos, list, us);
-	list = generate_pawns<NON_EVASIONS>(pos, list, us);
-	list = generate_castles<NON_EVASIONS>(pos, list, us);
-	return list;
-}
-
-template<>
-ActMove* generate_moves<EVASIONS>(const Board& pos, ActMove* list){
-	Side us = pos.side_to_move();
-	list = generate_evasions<EVASIONS>(pos, list, us);
-	return list;
-}
 
-template<>
-ActMove* generate_moves<CAPTURES>(const Board& pos, ActMove* list){
-	Side us = pos.side_to_move();
-	list = generate_sliders_knight<CAPTURES>(pos, list, us);
-	list = generate_king<CAPTURES>(pos, list, us);
-	list = generate_pawns<CAPTURES>(pos, list, us);
+template<GenType T, bool Legal>
+ActMove* generate_all(const Board& pos, ActMove* list, const LegalMasks& lm){
+	const Side us = pos.side_to_move();
+	if(T == EVASIONS){
+		return generate_evasions<Legal>(pos, list, us, lm);
+	}
+	list = generate_sliders_knight<T, Legal>(pos, list, us, lm);
+	if(T != QUIET_CHECKS) list = generate_king<T, Legal>(pos, list, us);
+	list = generate_pawns<T, Legal>(pos, list, us, lm);
+	if((T != CAPTURES) && !(Legal && pos.checkers())) list = generate_castles<T>(pos, list, us);
 	return list;
 }
 
-template<>
-ActMove* generate_moves<NON_CAPTURES>(const Board& pos, ActMove* list){
-	Side us = pos.side_to_move();
-	list = generate_sliders_knight<NON_CAPTURES>(pos, list, us);
-	list = generate_king<NON_CAPTURES>(pos, list, us);
-	list = generate_pawns<NON_CAPTURES>(pos, list, us);
-	list = generate_castles<NON_CAPTURES>(pos, list, us);
-	return list;
+template<GenType T>
+ActMove* generate_moves(const Board& pos, ActMove* list){
+	return generate_all<T, false>(pos, list, LegalMasks());
 }
 
-template<>
-ActMove* generate_moves<QUIET_CHECKS>(const Board& pos, ActMove* list){
-	Side us = pos.side_to_move();
-	list = generate_sliders_knight<QUIET_CHECKS>(pos, list, us);
-	list = generate_pawns<QUIET_CHECKS>(pos, list, us);
-	list = generate_castles<QUIET_CHECKS>(pos, list, us);
-	return list;
+template<GenType T>
+ActMove* generate_legal(const Board& pos, ActMove* list){
+	// Pins and checks are worked out up front, so everything generated here is legal. //
+	LegalMasks lm;
+	const Bitboard chk = pos.checkers();
+	lm.ksq = pos.king_sq(pos.side_to_move());
+	lm.pinned = pos.pinned(pos.side_to_move());
+	lm.target = !chk ? ~Bitboard(0) : more_than_one(chk) ? Bitboard(0) : (between_bb(lm.ksq, lsb(chk)) | chk);
+	return generate_all<T, true>(pos, list, lm);
 }
 
 template<>
 ActMove* generate_moves<LEGAL>(const Board& pos, ActMove* list){
-	// This generates all *legal* moves, which are verified to be legal and not just pseudo-legal. //
-	Bitboard pinned = pos.pinned(pos.side_to_move());
-	const Square ksq = pos.king_sq(pos.side_to_move());
-	ActMove* on = list; // start of list
-	list = (pos.checkers() ? generate_moves<EVASIONS>(pos, list) : generate_moves<NON_EVASIONS>(pos, list)); // now points to end of list
-	while(on != list){ // as long as we aren't at the end
-		if((pinned || (from_sq(on->move) == ksq) || (type_of(on->move) == ENPASSANT)) && !pos.legal(on->move, pinned)){
-			on->move = (--list)->move; // take it from the end and overwrite current invalid one without incrementing so we visit this
-		} else ++on;
-	}
-	return list;
+	// This generates all *legal* moves. //
+	return pos.checkers() ? generate_legal<EVASIONS>(pos, list) : generate_legal<NON_EVASIONS>(pos, list);
 }
 
+template ActMove* generate_moves<NON_EVASIONS>(const Board& pos, ActMove* list); // explicit instantiations
+template ActMove* generate_moves<EVASIONS>(const Board& pos, ActMove* list);
+template ActMove* generate_moves<CAPTURES>(const Board& pos, ActMove* list);
+template ActMove* generate_moves<NON_CAPTURES>(const Board& pos, ActMove* list);
+template ActMove* generate_moves<QUIET_CHECKS>(const Board& pos, ActMove* list);
+template ActMove* generate_legal<EVASIONS>(const Board& pos, ActMove* list);
+template ActMove* generate_legal<CAPTURES>(const Board& pos, ActMove* list);
+template ActMove* generate_legal<NON_CAPTURES>(const Board& pos, ActMove* list);
+template ActMove* generate_legal<QUIET_CHECKS>(const Board& pos, ActMove* list);
+
 
 
 
@@ -34,6 +34,9 @@ enum GenType {
 template<GenType>
 ActMove* generate_moves(const Board& pos, ActMove* list); // returns end of list (meaning one *after* last move generated)
 
+template<GenType>
+ActMove* generate_legal(const Board& pos, ActMove* list); // same as above, but only legal moves (pins and checks are masked out while generating)
+
 template<GenType T>
 struct MoveList {
 	// Holds pseudo-legal moves generated and provides useful methods. //
@@ -6,8 +6,10 @@
 
 enum {
 	// Stages //
+	// Note: The first stage of each cycle returns the TT move (if/a).
 	REGULAR, // regular search (at d > 0)
 		CAPTURES_S1, // winning captures
+		KILLERS_S1, // killers and the counter move
 		QUIETS_S1, // quiets with positive history value
 		QUIETS_S2, // quiets with negative history value
 		BAD_CAPTURES_S1, // bad captures
@@ -18,7 +20,8 @@ enum {
 		QS_CHECKS_S1, // quiet checks
 	QSEARCH_1, // QS without checks
 		QS_CAPTURES_S2,
-	// TODO: ProbCut
+	PROBCUT, // ProbCut
+		PROBCUT_CAPTURES_S1, // captures with SEE above the threshold
 	RECAPTURE, // QS recaptures
 		RECAPTURE_S1, // QS recaptures
 	STOP // when we are done
@@ -46,15 +49,22 @@ inline ActMove* pick_best(ActMove* begin, ActMove* end){
 	return begin; // since it is now swapped
 }
 
-MoveSorter::MoveSorter(const Board& p, Depth d, const HistoryTable& ht, Search::Stack* s) : pos(p), hst(ht), ss(s), depth(d) {
+// The TT move can be garbage from a hash collision, so it is checked before //
+// it is handed out (and since it comes first, a cutoff saves generating anything).
+// Everything generated is already legal, so the TT move and killers are the
+// only moves that need a legality check here.
+
+MoveSorter::MoveSorter(const Board& p, Move ttm, Depth d, const HistoryTable& ht, Move cm, Search::Stack* s) : pos(p), hst(ht), ss(s), depth(d), counter_move(cm) {
 	assert(d > DEPTH_ZERO); // only main search
 	cur = end = moves; // reset current and end
 	end_bad_captures = moves + MAX_MOVES - 1; // the end of the array
 	if(pos.checkers()) stage = EVASION;
 	else stage = REGULAR;
+	tt_move = (ttm && pos.pseudo_legal(ttm) && pos.legal(ttm, pos.pinned(pos.side_to_move()))) ? ttm : MOVE_NONE;
+	end += (tt_move != MOVE_NONE);
 }
 
-MoveSorter::MoveSorter(const Board& p, Depth d, const HistoryTable& ht, Square s) : pos(p), hst(ht), cur(moves), end(moves) {
+MoveSorter::MoveSorter(const Board& p, Move ttm, Depth d, const HistoryTable& ht, Square s) : pos(p), hst(ht), cur(moves), end(moves) {
 	assert(d <= DEPTH_ZERO); // only QS search
 	if(pos.checkers()){
 		stage = EVASION;
@@ -62,10 +72,21 @@ MoveSorter::MoveSorter(const Board& p, Depth d, const HistoryTable& ht, Square s
 		stage = QSEARCH_0;
 	} else if(d > DEPTH_QS_RECAPTURES){
 		stage = QSEARCH_1;
+		ttm = (ttm && pos.is_capture(ttm)) ? ttm : MOVE_NONE; // only captures from now on
 	} else {
 		stage = RECAPTURE;
 		recap_sq = s;
+		ttm = (ttm && pos.is_capture(ttm) && (to_sq(ttm) == recap_sq)) ? ttm : MOVE_NONE;
 	}
+	tt_move = (ttm && pos.pseudo_legal(ttm) && pos.legal(ttm, pos.pinned(pos.side_to_move()))) ? ttm : MOVE_NONE;
+	end += (tt_move != MOVE_NONE);
+}
+
+MoveSorter::MoveSorter(const Board& p, Move ttm, const HistoryTable& ht, Value th) : pos(p), hst(ht), threshold(th), cur(moves), end(moves) {
+	assert(!pos.checkers());
+	stage = PROBCUT;
+	tt_move = (ttm && pos.pseudo_legal(ttm) && pos.legal(ttm, pos.pinned(pos.side_to_move())) && pos.is_capture(ttm) && pos.see_ge(ttm, threshold + 1)) ? ttm : MOVE_NONE;
+	end += (tt_move != MOVE_NONE);
 }
 
 template<>
@@ -89,18 +110,18 @@ void MoveSorter::score<NON_CAPTURES>(void){
 	// For non-captures/quiets, we use the history value for sorting. //
 	for(ActMove* it = cur; it != end; it++){
 		Move m = it->move;
-		it->value = hst[pos.moved_piece(m)][to_sq(m)];
+		it->value = quiet_score(hst, ss, pos.moved_piece(m), to_sq(m));
 	}
 }
 
 template<>
 void MoveSorter::score<EVASIONS>(void){
 	Move m;
-	Value see;
 	for(ActMove* it = cur; it != end; it++){
 		m = it->move;
-		if((see = pos.see_sign(m)) < VAL_ZERO){
-			it->value = see - HistoryTable::Max; // move losing captures to bottom
+		if(!pos.see_ge(m)){
+			// Move losing captures to the bottom, roughly by how much we stand to lose. //
+			it->value = PieceValue[MG][type_of(pos.at(to_sq(m)))] - PieceValue[MG][type_of(pos.moved_piece(m))] - HistoryTable::Max;
 		} else if(pos.is_capture(m)){
 			it->value = PieceValue[MG][type_of(pos.at(to_sq(m)))] - Value(type_of(pos.moved_piece(m))) + HistoryTable::Max; // move winning captures to top
 		} else {
@@ -112,12 +133,22 @@ void MoveSorter::score<EVASIONS>(void){
 void MoveSorter::gen_next_stage(void){
 	cur = moves; // start from the beginning
 	switch(++stage){
-		case CAPTURES_S1: case QS_CAPTURES_S1: case QS_CAPTURES_S2: case RECAPTURE_S1:
-			end = generate_moves<CAPTURES>(pos, moves);
+		case CAPTURES_S1: case QS_CAPTURES_S1: case QS_CAPTURES_S2: case PROBCUT_CAPTURES_S1: case RECAPTURE_S1:
+			end = generate_legal<CAPTURES>(pos, moves);
 			score<CAPTURES>();
 			return;
+		case KILLERS_S1:
+			cur = killers;
+			end = killers + 2;
+			killers[0].move = ss->killers[0];
+			killers[1].move = ss->killers[1];
+			killers[2].move = MOVE_NONE;
+			if((counter_move != killers[0].move) && (counter_move != killers[1].move)){
+				(end++)->move = counter_move;
+			}
+			return;
 		case QUIETS_S1:
-			end_quiets = end = generate_moves<NON_CAPTURES>(pos, moves);
+			end_quiets = end = generate_legal<NON_CAPTURES>(pos, moves);
 			score<NON_CAPTURES>();
 			end = std::partition(cur, end, has_positive_score); // for first quiet stage, only positive history value quiets
 			stable_insertion_sort(cur, end);
@@ -139,14 +170,14 @@ void MoveSorter::gen_next_stage(void){
 			end = end_bad_captures; // should be <= cur now since we will pick in reverse order
 			return;
 		case EVASIONS_S1:
-			end = generate_moves<EVASIONS>(pos, moves);
+			end = generate_legal<EVASIONS>(pos, moves);
 			score<EVASIONS>();
 			return;
 		case QS_CHECKS_S1:
-			end = generate_moves<QUIET_CHECKS>(pos, moves);
+			end = generate_legal<QUIET_CHECKS>(pos, moves);
 			// No need to score the *quiet* checks --> emphasis on *quiet*
 			return;
-		case EVASION: case QSEARCH_0: case QSEARCH_1: case RECAPTURE:
+		case EVASION: case QSEARCH_0: case QSEARCH_1: case PROBCUT: case RECAPTURE:
 			// If we are at one of these, then we completed all stages of a previous cycle. //
 			stage = STOP;
 			/* Fall through */
@@ -165,32 +196,57 @@ Move MoveSorter::next_move(void){
 		switch(stage){
 			case STOP:
 				return MOVE_NONE;
+			case REGULAR: case EVASION: case QSEARCH_0: case QSEARCH_1: case PROBCUT: case RECAPTURE:
+				++cur;
+				return tt_move;
 			case CAPTURES_S1:
 				m = pick_best(cur++, end)->move; // pick_best also moves it to the beginning, so this works
-				if(pos.see_sign(m) >= VAL_ZERO){ // only winning/equal captures right now
+				if(m == tt_move){
+					break; // already tried it
+				}
+				if(pos.see_ge(m)){ // only winning/equal captures right now
 					return m;
 				}
 				(end_bad_captures--)->move = m; // move to end for bad captures - deal with later
 				break;
+			case KILLERS_S1:
+				m = (cur++)->move;
+				// Killers come from other positions, so they have to be checked here. //
+				if((m != MOVE_NONE) && (m != tt_move) && !pos.is_capture(m) && pos.pseudo_legal(m) && pos.legal(m, pos.pinned(pos.side_to_move()))){
+					return m;
+				}
+				break;
 			case QUIETS_S1: case QUIETS_S2:
 				m = (cur++)->move;
-				// TODO: Check against TT move, killers, etc.
-				return m;
+				if((m != tt_move) && (m != killers[0].move) && (m != killers[1].move) && (m != killers[2].move)){
+					return m;
+				}
+				break;
 			case BAD_CAPTURES_S1:
 				return (cur--)->move;
 			case EVASIONS_S1: case QS_CAPTURES_S1: case QS_CAPTURES_S2:
 				m = pick_best(cur++, end)->move;
-				// TODO: Check against TT move
-				return m;
+				if(m != tt_move){
+					return m;
+				}
+				break;
+			case PROBCUT_CAPTURES_S1:
+				m = pick_best(cur++, end)->move;
+				if((m != tt_move) && pos.see_ge(m, threshold + 1)){ // only captures that win enough
+					return m;
+				}
+				break;
 			case RECAPTURE_S1:
 				m = pick_best(cur++, end)->move;
-				if(to_sq(m) == recap_sq){
+				if((m != tt_move) && (to_sq(m) == recap_sq)){
 					return m;
 				}
 				break;
 			case QS_CHECKS_S1:
 				m = (cur++)->move; // no need to use pick_best in this case
-				// TODO: Check against TT move
+				if(m != tt_move){
+					return m;
+				}
 				break;
 			default:
 				assert(false);
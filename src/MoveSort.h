@@ -9,12 +9,22 @@
 
 template<typename T>
 struct Stats {
-	static const Value Max = Value(256);
+	static const int MaxBonus = 324; // updates must be smaller than this
+	static const Value Max = Value(MaxBonus * 32); // so entries always stay within (-Max, Max)
 	
 	void clear(void){
 		std::memset(table, 0, sizeof(table));
 	}
 	
+	void age(void){
+		// Halves everything, so old results still count but new ones take over quickly. //
+		for(Piece pc = NO_PIECE; pc < PIECE_NB; pc++){
+			for(Square s = SQ_A1; s <= SQ_H8; s++){
+				table[pc][s] = T(table[pc][s] / 2);
+			}
+		}
+	}
+	
 	const T* operator[](Piece pc) const {
 		// Returns an array given the moving piece
 		// that contains the scores and can be
@@ -22,23 +32,46 @@ struct Stats {
 		return table[pc];
 	}
 	
+	T* operator[](Piece pc){
+		return table[pc];
+	}
+	
 	void register_update(Piece pc, Square to, Value v){
-		// This increases the score of the given moving piece/dest. square
-		// combo given the added score.
-		if(abs(table[pc][to] + v) < Max){
-			table[pc][to] += v;
-		}
+		// This adds the given bonus (or penalty) with "gravity": the closer an entry
+		// is to the limit, the more it is pulled back, so it never saturates.
+		assert(abs(v) < MaxBonus);
+		int e = table[pc][to];
+		e += int(v) * 32 - e * abs(int(v)) / MaxBonus;
+		table[pc][to] = T(e);
+	}
+	
+	void update(Piece pc, Square to, Move m){
+		// For move tables (e.g. counter moves), this just replaces the stored move. //
+		table[pc][to] = m;
 	}
 private:
 	T table[PIECE_NB][SQUARE_NB];
 };
 
 typedef Stats<Value> HistoryTable;
+typedef Stats<Move> CounterMovesTable; // the move that refuted the previous move by [piece][to]
+typedef Stats<Value> PieceToHistory; // history of a move following a certain move
+typedef Stats<PieceToHistory> ContinuationHistory; // the PieceToHistory for each previous move by [piece][to]
+
+inline Value quiet_score(const HistoryTable& hst, const Search::Stack* ss, Piece pc, Square to){
+	// The combined history of a quiet move: its own history plus how well it
+	// did after the previous move and after our own previous move.
+	Value v = hst[pc][to];
+	if((ss - 1)->cont_history) v += (*(ss - 1)->cont_history)[pc][to];
+	if((ss - 2)->cont_history) v += (*(ss - 2)->cont_history)[pc][to];
+	return v;
+}
 
 class MoveSorter {
 	public:
-		MoveSorter(const Board& pos, Depth d, const HistoryTable& hst, Search::Stack* ss); // for main search
-		MoveSorter(const Board& pos, Depth d, const HistoryTable& hst, Square s); // for QS search
+		MoveSorter(const Board& pos, Move ttm, Depth d, const HistoryTable& hst, Move cm, Search::Stack* ss); // for main search
+		MoveSorter(const Board& pos, Move ttm, Depth d, const HistoryTable& hst, Square s); // for QS search
+		MoveSorter(const Board& pos, Move ttm, const HistoryTable& hst, Value th); // for ProbCut
 		
 		Move next_move(void); // get the next move we should search
 	private:
@@ -51,7 +84,10 @@ class MoveSorter {
 		Depth depth;
 		int stage;
 		Square recap_sq;
-		// TODO: Killers
+		Value threshold; // for ProbCut
+		Move tt_move; // tried before anything is generated
+		Move counter_move;
+		ActMove killers[3]; // the two killers and the counter move
 		ActMove *cur, *end, *end_quiets, *end_bad_captures;
 		ActMove moves[MAX_MOVES];
 };
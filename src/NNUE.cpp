@@ -0,0 +1,253 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+#include "NNUE.h"
+#include <fstream>
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#elif defined(USE_SSE41)
+#include <smmintrin.h>
+#endif
+
+bool NNUE::Enabled = false;
+
+namespace {
+	using namespace NNUE;
+
+	const uint32_t FileVersion = 0x7AF32F16;
+	const int TransformedDims = 2 * HalfDims; // both accumulators, side to move first
+	const int L1 = 32, L2 = 32; // hidden layer sizes
+	const int WeightScaleBits = 6; // hidden layer outputs are shifted down by this much
+	const int OutputScale = 16; // network output units per (network) centipawn unit
+	const int NetPawnValueEg = 208; // the pawn value the networks were trained with
+	const int MaxUpdate = 16; // walk back at most this many states to find a computed accumulator
+
+	struct Network {
+		std::vector<int16_t> ft_biases; // [HalfDims]
+		std::vector<int16_t> ft_weights; // [InputDims][HalfDims]
+		std::vector<int32_t> b1, b2, b3; // [L1], [L2], [1]
+		std::vector<int8_t> w1, w2, w3; // [L1][TransformedDims], [L2][L1], [1][L2]
+	};
+
+	Network Net;
+	int NetId = 0; // incremented every time a network is loaded (0 = none)
+
+	// Features //
+
+	inline int orient(Side perspective, Square s){
+		// Black sees the board rotated. //
+		return int(s) ^ (perspective == WHITE ? 0 : 63);
+	}
+
+	inline int feature_index(Side perspective, int ksq, Piece pc, Square s){
+		// Pieces of the perspective's side come first for each piece type. //
+		const int ps = 1 + (2 * (type_of(pc) - PAWN) + (side_of(pc) != perspective)) * SQUARE_NB;
+		return orient(perspective, s) + ps + (PSEnd * ksq);
+	}
+
+	// Kernels //
+
+	inline void add_row(int16_t* acc, const int16_t* row){
+#if defined(USE_AVX2)
+		for(int i = 0; i < HalfDims; i += 16){
+			_mm256_storeu_si256((__m256i*)&acc[i], _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)&acc[i]), _mm256_loadu_si256((const __m256i*)&row[i])));
+		}
+#elif defined(USE_SSE41)
+		for(int i = 0; i < HalfDims; i += 8){
+			_mm_storeu_si128((__m128i*)&acc[i], _mm_add_epi16(_mm_loadu_si128((const __m128i*)&acc[i]), _mm_loadu_si128((const __m128i*)&row[i])));
+		}
+#else
+		for(int i = 0; i < HalfDims; i++){
+			acc[i] = int16_t(acc[i] + row[i]);
+		}
+#endif
+	}
+
+	inline void sub_row(int16_t* acc, const int16_t* row){
+#if defined(USE_AVX2)
+		for(int i = 0; i < HalfDims; i += 16){
+			_mm256_storeu_si256((__m256i*)&acc[i], _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)&acc[i]), _mm256_loadu_si256((const __m256i*)&row[i])));
+		}
+#elif defined(USE_SSE41)
+		for(int i = 0; i < HalfDims; i += 8){
+			_mm_storeu_si128((__m128i*)&acc[i], _mm_sub_epi16(_mm_loadu_si128((const __m128i*)&acc[i]), _mm_loadu_si128((const __m128i*)&row[i])));
+		}
+#else
+		for(int i = 0; i < HalfDims; i++){
+			acc[i] = int16_t(acc[i] - row[i]);
+		}
+#endif
+	}
+
+	inline void clip_accumulator(const int16_t* acc, uint8_t* out){
+		// Clamps to [0, 127]. //
+#if defined(USE_AVX2)
+		const __m256i zero = _mm256_setzero_si256();
+		for(int i = 0; i < HalfDims; i += 32){
+			const __m256i packed = _mm256_packs_epi16(_mm256_loadu_si256((const __m256i*)&acc[i]), _mm256_loadu_si256((const __m256i*)&acc[i + 16]));
+			_mm256_storeu_si256((__m256i*)&out[i], _mm256_permute4x64_epi64(_mm256_max_epi8(packed, zero), 0xD8)); // packs works within 128-bit lanes
+		}
+#elif defined(USE_SSE41)
+		const __m128i zero = _mm_setzero_si128();
+		for(int i = 0; i < HalfDims; i += 16){
+			const __m128i packed = _mm_packs_epi16(_mm_loadu_si128((const __m128i*)&acc[i]), _mm_loadu_si128((const __m128i*)&acc[i + 8]));
+			_mm_storeu_si128((__m128i*)&out[i], _mm_max_epi8(packed, zero));
+		}
+#else
+		for(int i = 0; i < HalfDims; i++){
+			out[i] = uint8_t(std::max(0, std::min(127, int(acc[i]))));
+		}
+#endif
+	}
+
+	template<int In>
+	inline int32_t dot(const uint8_t* in, const int8_t* w){
+		// Inputs are at most 127, so the pairwise 16-bit sums below can never saturate. //
+#if defined(USE_AVX2)
+		const __m256i ones = _mm256_set1_epi16(1);
+		__m256i sum = _mm256_setzero_si256();
+		for(int i = 0; i < In; i += 32){
+			const __m256i prod = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)&in[i]), _mm256_loadu_si256((const __m256i*)&w[i]));
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(prod, ones));
+		}
+		__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+		return _mm_cvtsi128_si32(s);
+#elif defined(USE_SSE41)
+		const __m128i ones = _mm_set1_epi16(1);
+		__m128i sum = _mm_setzero_si128();
+		for(int i = 0; i < In; i += 16){
+			const __m128i prod = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)&in[i]), _mm_loadu_si128((const __m128i*)&w[i]));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(prod, ones));
+		}
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+		return _mm_cvtsi128_si32(sum);
+#else
+		int32_t sum = 0;
+		for(int i = 0; i < In; i++){
+			sum += int32_t(in[i]) * int32_t(w[i]);
+		}
+		return sum;
+#endif
+	}
+
+	template<int In, int Out>
+	inline void hidden_layer(const uint8_t* in, const int8_t* w, const int32_t* b, uint8_t* out){
+		// Affine transform followed by a clipped ReLU. //
+		for(int o = 0; o < Out; o++){
+			const int32_t sum = b[o] + dot<In>(in, &w[o * In]);
+			out[o] = uint8_t(std::max(0, std::min(127, sum >> WeightScaleBits)));
+		}
+	}
+
+	// Accumulator //
+
+	void refresh(const Board& pos, Accumulator& acc, Side perspective){
+		int16_t* a = acc.accumulation[perspective];
+		std::memcpy(a, &Net.ft_biases[0], sizeof(int16_t) * HalfDims);
+		const int ksq = orient(perspective, pos.king_sq(perspective));
+		for(Bitboard b = pos.all() & ~pos.pieces(KING); b; ){
+			const Square s = pop_lsb(&b);
+			add_row(a, &Net.ft_weights[size_t(feature_index(perspective, ksq, pos.at(s), s)) * HalfDims]);
+		}
+	}
+
+	void apply(const DirtyPiece& dp, int16_t* a, Side perspective, int ksq){
+		for(int i = 0; i < dp.num; i++){
+			if(type_of(dp.piece[i]) == KING) continue; // kings are not features
+			if(dp.from[i] != SQ_NONE){
+				sub_row(a, &Net.ft_weights[size_t(feature_index(perspective, ksq, dp.piece[i], dp.from[i])) * HalfDims]);
+			}
+			if(dp.to[i] != SQ_NONE){
+				add_row(a, &Net.ft_weights[size_t(feature_index(perspective, ksq, dp.piece[i], dp.to[i])) * HalfDims]);
+			}
+		}
+	}
+
+	// Loading //
+
+	template<typename T>
+	bool read(std::ifstream& ifs, std::vector<T>& v, size_t n){
+		v.resize(n);
+		ifs.read((char*)&v[0], std::streamsize(n * sizeof(T))); // the files are little-endian, like everything we run on
+		return bool(ifs);
+	}
+
+	bool read_u32(std::ifstream& ifs, uint32_t& v){
+		ifs.read((char*)&v, sizeof(v));
+		return bool(ifs);
+	}
+}
+
+bool NNUE::loaded(void){
+	return NetId != 0;
+}
+
+bool NNUE::load(const std::string& path){
+	std::ifstream ifs(path.c_str(), std::ios::binary);
+	if(!ifs.is_open()) return false;
+	uint32_t version, hash, desc_len;
+	if(!read_u32(ifs, version) || (version != FileVersion) || !read_u32(ifs, hash) || !read_u32(ifs, desc_len)) return false;
+	ifs.ignore(desc_len); // network description
+	Network n;
+	// Each part is preceded by a hash of its architecture, which we don't check (the version and size do). //
+	if(!read_u32(ifs, hash) || !read(ifs, n.ft_biases, HalfDims) || !read(ifs, n.ft_weights, size_t(InputDims) * HalfDims)) return false;
+	if(!read_u32(ifs, hash)) return false;
+	if(!read(ifs, n.b1, L1) || !read(ifs, n.w1, L1 * TransformedDims)) return false;
+	if(!read(ifs, n.b2, L2) || !read(ifs, n.w2, L2 * L1)) return false;
+	if(!read(ifs, n.b3, 1) || !read(ifs, n.w3, L2)) return false;
+	if(ifs.peek() != EOF) return false; // wrong architecture
+	std::swap(Net, n);
+	++NetId; // every accumulator computed so far is stale now
+	return true;
+}
+
+void NNUE::update_accumulator(const Board& pos){
+	BoardState* const st = pos.state();
+	if(st->accumulator.net_id == NetId) return;
+	// Find the nearest state with a computed accumulator that we can update from. //
+	const BoardState* path[MaxUpdate];
+	int n = 0;
+	const BoardState* base = st;
+	while((base->accumulator.net_id != NetId) && (base->dirty.num >= 0) && base->prev && (n < MaxUpdate)){
+		path[n++] = base;
+		base = base->prev;
+	}
+	const bool usable = (base->accumulator.net_id == NetId);
+	for(Side c = WHITE; c <= BLACK; c++){
+		bool king_moved = false;
+		for(int i = 0; i < n && !king_moved; i++){
+			for(int j = 0; j < path[i]->dirty.num; j++){
+				king_moved |= (path[i]->dirty.piece[j] == make_piece(c, KING));
+			}
+		}
+		if(!usable || king_moved){
+			refresh(pos, st->accumulator, c);
+			continue;
+		}
+		int16_t* a = st->accumulator.accumulation[c];
+		std::memcpy(a, base->accumulator.accumulation[c], sizeof(int16_t) * HalfDims);
+		const int ksq = orient(c, pos.king_sq(c));
+		for(int i = n - 1; i >= 0; i--){ // oldest move first
+			apply(path[i]->dirty, a, c, ksq);
+		}
+	}
+	st->accumulator.net_id = NetId;
+}
+
+Value NNUE::evaluate(const Board& pos){
+	assert(loaded());
+	update_accumulator(pos);
+	const Accumulator& acc = pos.state()->accumulator;
+	const Side us = pos.side_to_move();
+	uint8_t transformed[TransformedDims], h1[L1], h2[L2];
+	clip_accumulator(acc.accumulation[us], &transformed[0]);
+	clip_accumulator(acc.accumulation[~us], &transformed[HalfDims]);
+	hidden_layer<TransformedDims, L1>(transformed, &Net.w1[0], &Net.b1[0], h1);
+	hidden_layer<L1, L2>(h1, &Net.w2[0], &Net.b2[0], h2);
+	const int32_t out = Net.b3[0] + dot<L2>(h2, &Net.w3[0]);
+	const int v = int((int64_t(out) * int(PawnValueEg)) / (OutputScale * NetPawnValueEg)); // to our pawn value
+	return Value(std::max(int(VAL_MATED_IN_MAX_PLY) + 1, std::min(int(VAL_MATE_IN_MAX_PLY) - 1, v)));
+}
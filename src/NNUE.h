@@ -0,0 +1,45 @@
+#ifndef NNUE_INC
+#define NNUE_INC
+
+#include "Common.h"
+
+/*
+* An efficiently updatable neural network evaluator (HalfKP 256x2-32-32-1, the same layout and file format
+* as the first Stockfish networks).
+* Inputs: for each side, every (own king square, non-king piece, square) triple, 64 * 641 = 41024 features.
+* The feature transformer turns the active features into 256 int16 values per side (the accumulator),
+* which do_move() does not recompute: it only records which pieces moved, and the accumulator is
+* updated from the nearest computed one when the position is evaluated (unless that side's king moved).
+* The rest of the network is three small int8 layers with clipped ReLU activations.
+* Build with USE_AVX2 or USE_SSE41 defined for the SIMD kernels (the scalar ones give the same results).
+*/
+
+class Board;
+
+namespace NNUE {
+	const int HalfDims = 256; // accumulator size per side
+	const int PSEnd = 10 * SQUARE_NB + 1; // features per king square (piece types b/w pawn and queen for both sides, + 1 unused)
+	const int InputDims = SQUARE_NB * PSEnd;
+
+	struct Accumulator {
+		int16_t accumulation[SIDE_NB][HalfDims]; // by perspective
+		int net_id; // the network this was computed with (0 = not computed)
+	};
+
+	struct DirtyPiece {
+		// Pieces changed by the last move (at most 3: a promotion with a capture, or castling). //
+		int num; // -1 if the previous state cannot be used (set up from a FEN or copied from another board)
+		Piece piece[3];
+		Square from[3]; // SQ_NONE if the piece was added
+		Square to[3]; // SQ_NONE if the piece was removed
+	};
+
+	extern bool Enabled; // evaluate with the network (only if one is loaded)
+
+	bool load(const std::string& path); // load a network file (keeps the old one on failure)
+	bool loaded(void);
+	Value evaluate(const Board& pos); // relative to the side to move
+	void update_accumulator(const Board& pos); // bring the accumulator of the current state up to date
+}
+
+#endif // #ifndef NNUE_INC
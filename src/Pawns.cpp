@@ -4,19 +4,23 @@
 #include "MoveGen.h"
 #include "Evaluation.h"
 #include "Pawns.h"
+#include "Threads.h"
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#endif
 
 #define S(mg, eg) make_score(mg, eg)
 
-HashTable<Pawns::PawnEntry, 16384> PawnHashTable;
+Pawns::PawnTable PawnHashTable; // for positions not being searched by a thread
 
 // Doubled Pawn Penalty by [file] //
-const Score Doubled[FILE_NB] = {
+Score Doubled[FILE_NB] = {
 	S(13, 43), S(20, 48), S(23, 48), S(23, 48),
 	S(23, 48), S(23, 48), S(20, 48), S(13, 43) 
 };
 
 // Isolated pawn penalty by [opposed][file] //
-const Score Isolated[2][FILE_NB] = {
+Score Isolated[2][FILE_NB] = {
 	{ 
 		S(37, 45), S(54, 52), S(60, 52), S(60, 52),
 		S(60, 52), S(60, 52), S(54, 52), S(37, 45)
@@ -28,7 +32,7 @@ const Score Isolated[2][FILE_NB] = {
 };
 
 // Backward pawn penalty by [opposed][file] //
-const Score Backward[2][FILE_NB] = {
+Score Backward[2][FILE_NB] = {
 	{ 
 		S(30, 42), S(43, 46), S(49, 46), S(49, 46),
 		S(49, 46), S(49, 46), S(43, 46), S(30, 42)
@@ -67,9 +71,21 @@ void Pawns::init(void){
 
 template<Side Us> Score evaluate(const Board& pos, Pawns::PawnEntry* e);
 
+template<Side Us>
+inline bool is_backward(Square s, Bitboard our_pawns, Bitboard their_pawns){
+	// The stop square of a backwards pawn is not protected but is attacked by an opposing
+	// sentry, meaning that this pawn really has no hope to be promoted.
+	// Note: Only for pawns that are not passed, isolated, connected or levers, and have no own pawns behind on adjacent files.
+	const Square Up = (Us == WHITE ? DELTA_N : DELTA_S);
+	Bitboard b = pawn_attack_span(Us, s) & (their_pawns | our_pawns); // now we have all pawns ahead of on adjacent files
+	b = pawn_attack_span(Us, s) & rank_bb(backmost_sq(Us, b)); // and we get the rank of the closest pawn ahead of us on an adjacent file
+	return (b | shift_bb<Up>(b)) & their_pawns; // if we find an enemy pawn waiting to take us, this pawn is backwards
+}
+
 Pawns::PawnEntry* Pawns::probe(const Board& pos){
 	Key pawnKey = pos.pawn_key();
-	Pawns::PawnEntry* ent = PawnHashTable[pawnKey];
+	SearchThread* th = pos.this_thread();
+	Pawns::PawnEntry* ent = (th ? th->pawns_table[pawnKey] : PawnHashTable[pawnKey]);
 	if(ent->key == pawnKey) return ent;
 	ent->key = pawnKey;
 	ent->score = evaluate<WHITE>(pos, ent) - evaluate<BLACK>(pos, ent);
@@ -79,11 +95,9 @@ Pawns::PawnEntry* Pawns::probe(const Board& pos){
 template<Side Us>
 Score evaluate(const Board& pos, Pawns::PawnEntry* e){
 	const Side Them = (Us == WHITE ? BLACK : WHITE);
-    const Square Up = (Us == WHITE ? DELTA_N : DELTA_S);
     const Square Right = (Us == WHITE ? DELTA_NE : DELTA_SW);
     const Square Left = (Us == WHITE ? DELTA_NW : DELTA_SE);
 	Score score = SCORE_ZERO;
-	Bitboard b; // just a temporary for calculations
 	Bitboard our_pawns = pos.pieces(Us, PAWN);
 	Bitboard their_pawns = pos.pieces(Them, PAWN);
 	e->passedPawns[Us] = 0;
@@ -104,16 +118,7 @@ Score evaluate(const Board& pos, Pawns::PawnEntry* e){
 		bool opposed = their_pawns & forward_bb(Us, s); // if we are opposed
 		bool passed = !(their_pawns & passed_pawn_mask(Us, s)); // if we are "passed" (naively)
 		bool lever = StepAttacksBB[make_piece(Us, PAWN)][s] & their_pawns; // if we are a lever - e.g. attacking their pawns
-		bool backward;
-		if(passed || isolated || connected || lever || (our_pawns & pawn_attack_span(Them, s))){
-			backward = false;
-		} else {
-			// The stop square of a backwards pawn is not protected but is attacked by an opposing
-			// sentry, meaning that this pawn really has no hope to be promoted.
-			b = pawn_attack_span(Us, s) & (their_pawns | our_pawns); // now we have all pawns ahead of on adjacent files
-			b = pawn_attack_span(Us, s) & rank_bb(backmost_sq(Us, b)); // and we get the rank of the closest pawn ahead of us on an adjacent file
-			backward = (b | shift_bb<Up>(b)) & their_pawns; // if we find an enemy pawn waiting to take us, this pawn is backwards
-		}
+		bool backward = !(passed || isolated || connected || lever || (our_pawns & pawn_attack_span(Them, s))) && is_backward<Us>(s, our_pawns, their_pawns);
 		assert(opposed || passed || (pawn_attack_span(Us, s) & their_pawns)); // one of these *has* to be true
 		if(passed && !doubled){
 			// We only care about the frontmost passed pawn since anything
@@ -207,4 +212,151 @@ Score evaluate(const Board& pos, Pawns::PawnEntry* e){
 
 
 
-	
\ No newline at end of file
+	
+/*
+* Batched pawn evaluation: the pawn bitboards of a group of positions are laid out side by side
+* (structure of arrays) and every per-pawn property (isolated, passed, doubled, etc.) is found for
+* all of them at once with set-wise shifts, four positions per AVX2 register.
+* Only the table lookups are left for each pawn, and the result is the same as evaluate() above.
+*/
+
+namespace {
+	const int Lanes = 4; // positions per group
+
+	struct BB4 {
+		// One bitboard per position in the group. //
+#if defined(USE_AVX2)
+		__m256i v;
+		BB4(void){ }
+		explicit BB4(__m256i x) : v(x) { }
+		explicit BB4(Bitboard b) : v(_mm256_set1_epi64x(int64_t(b))) { }
+		static BB4 load(const Bitboard* p){ return BB4(_mm256_loadu_si256((const __m256i*)p)); }
+		void store(Bitboard* p) const { _mm256_storeu_si256((__m256i*)p, v); }
+		BB4 operator&(const BB4 o) const { return BB4(_mm256_and_si256(v, o.v)); }
+		BB4 operator|(const BB4 o) const { return BB4(_mm256_or_si256(v, o.v)); }
+		BB4 operator~(void) const { return BB4(_mm256_xor_si256(v, _mm256_set1_epi64x(-1))); }
+		BB4 operator<<(const int n) const { return BB4(_mm256_slli_epi64(v, n)); }
+		BB4 operator>>(const int n) const { return BB4(_mm256_srli_epi64(v, n)); }
+#else
+		Bitboard v[Lanes];
+		BB4(void){ }
+		explicit BB4(Bitboard b){ for(int i = 0; i < Lanes; i++) v[i] = b; }
+		static BB4 load(const Bitboard* p){ BB4 r; for(int i = 0; i < Lanes; i++) r.v[i] = p[i]; return r; }
+		void store(Bitboard* p) const { for(int i = 0; i < Lanes; i++) p[i] = v[i]; }
+		BB4 operator&(const BB4 o) const { BB4 r; for(int i = 0; i < Lanes; i++) r.v[i] = v[i] & o.v[i]; return r; }
+		BB4 operator|(const BB4 o) const { BB4 r; for(int i = 0; i < Lanes; i++) r.v[i] = v[i] | o.v[i]; return r; }
+		BB4 operator~(void) const { BB4 r; for(int i = 0; i < Lanes; i++) r.v[i] = ~v[i]; return r; }
+		BB4 operator<<(const int n) const { BB4 r; for(int i = 0; i < Lanes; i++) r.v[i] = v[i] << n; return r; }
+		BB4 operator>>(const int n) const { BB4 r; for(int i = 0; i < Lanes; i++) r.v[i] = v[i] >> n; return r; }
+#endif
+	};
+
+	template<Square Delta>
+	inline BB4 shift(const BB4 b){
+		// Same as shift_bb(), plus east and west. //
+		return  Delta == DELTA_N  ?  b                    << 8 : Delta == DELTA_S  ?  b                  >> 8
+				: Delta == DELTA_E  ? (b & BB4(~FileHBB)) << 1 : Delta == DELTA_W  ? (b & BB4(~FileABB)) >> 1
+				: Delta == DELTA_NE ? (b & BB4(~FileHBB)) << 9 : Delta == DELTA_SE ? (b & BB4(~FileHBB)) >> 7
+				: Delta == DELTA_NW ? (b & BB4(~FileABB)) << 7 : (b & BB4(~FileABB)) >> 9;
+	}
+
+	template<Square Delta>
+	inline BB4 fill(BB4 b){
+		// Smears every bit all the way north or south. //
+		b = b | shift<Delta>(b);
+		b = b | ((Delta == DELTA_N) ? (b << 16) : (b >> 16));
+		return b | ((Delta == DELTA_N) ? (b << 32) : (b >> 32));
+	}
+
+	inline BB4 adjacent(const BB4 b){
+		return shift<DELTA_E>(b) | shift<DELTA_W>(b);
+	}
+
+	struct PawnMasks {
+		// The pawns of one side with each property, by [lane]. //
+		Bitboard attacks[Lanes], files[Lanes], isolated[Lanes], supported[Lanes], phalanx[Lanes];
+		Bitboard doubled[Lanes], opposed[Lanes], passed[Lanes], lever[Lanes], maybe_backward[Lanes];
+	};
+
+	template<Side Us>
+	void find_masks(const BB4 our, const BB4 their, PawnMasks& m){
+		// The set-wise version of each test in evaluate(). //
+		const Square Up = (Us == WHITE ? DELTA_N : DELTA_S), Down = (Us == WHITE ? DELTA_S : DELTA_N);
+		const Square Right = (Us == WHITE ? DELTA_NE : DELTA_SW), Left = (Us == WHITE ? DELTA_NW : DELTA_SE);
+		const Square TheirRight = (Us == WHITE ? DELTA_SW : DELTA_NE), TheirLeft = (Us == WHITE ? DELTA_SE : DELTA_NW);
+		const BB4 attacks = shift<Right>(our) | shift<Left>(our);
+		const BB4 behind_ours = fill<Down>(shift<Down>(our)); // squares with one of our pawns ahead on the same file
+		const BB4 behind_theirs = fill<Down>(shift<Down>(their)); // squares with one of their pawns ahead on the same file
+		const BB4 isolated = our & ~adjacent(fill<DELTA_N>(our) | fill<DELTA_S>(our));
+		const BB4 supported = our & attacks;
+		const BB4 phalanx = our & adjacent(our);
+		const BB4 passed = our & ~(behind_theirs | adjacent(behind_theirs));
+		const BB4 lever = our & (shift<TheirRight>(their) | shift<TheirLeft>(their));
+		attacks.store(m.attacks);
+		(fill<DELTA_N>(our) | fill<DELTA_S>(our)).store(m.files);
+		isolated.store(m.isolated);
+		supported.store(m.supported);
+		phalanx.store(m.phalanx);
+		(our & behind_ours).store(m.doubled);
+		(our & behind_theirs).store(m.opposed);
+		passed.store(m.passed);
+		lever.store(m.lever);
+		(our & ~(passed | isolated | supported | phalanx | lever | adjacent(fill<Up>(shift<Up>(our))))).store(m.maybe_backward);
+	}
+
+	template<Side Us>
+	Score score_pawns(const PawnMasks& m, int i, Bitboard our_pawns, Bitboard their_pawns, Pawns::PawnEntry* e){
+		// Adds up the bonuses and penalties for one position from its masks. //
+		Score score = SCORE_ZERO;
+		e->pawnAttks[Us] = m.attacks[i];
+		e->passedPawns[Us] = m.passed[i] & ~m.doubled[i];
+		e->kingSqs[Us] = SQ_NONE;
+		e->kingSafety[Us] = SCORE_ZERO;
+		e->semiopenFiles[Us] = int(~m.files[i] & 0xFF);
+		for(Bitboard pawns = our_pawns; pawns; ){
+			const Square s = pop_lsb(&pawns);
+			const File f = file_of(s);
+			const bool opposed = m.opposed[i] & s;
+			if(m.isolated[i] & s){
+				score -= Isolated[opposed][f];
+			} else if(!(m.supported[i] & s)){
+				score -= UnsupportedPawnPenalty;
+			}
+			if(m.doubled[i] & s){
+				score -= Doubled[f] / distance<Rank>(s, frontmost_sq(Us, our_pawns & forward_bb(Us, s)));
+			}
+			if((m.maybe_backward[i] & s) && is_backward<Us>(s, our_pawns, their_pawns)){
+				score -= Backward[opposed][f];
+			}
+			if((m.supported[i] | m.phalanx[i]) & s){
+				score += Connected[opposed][bool(m.phalanx[i] & s)][relative_rank(Us, s)];
+			}
+			if(m.lever[i] & s){
+				score += Lever[rank_of(s)];
+			}
+		}
+		return score;
+	}
+}
+
+void Pawns::evaluate_batch(const PackedBoard* positions, size_t n, Pawns::PawnEntry* entries){
+	Bitboard pawns[SIDE_NB][Lanes];
+	PawnMasks masks[SIDE_NB];
+	for(size_t base = 0; base < n; base += Lanes){
+		const int k = int(std::min(n - base, size_t(Lanes)));
+		for(int i = 0; i < Lanes; i++){
+			for(Side c = WHITE; c <= BLACK; c++){
+				pawns[c][i] = (i < k) ? (positions[base + i].bySide[c] & positions[base + i].byType[PAWN]) : 0;
+			}
+		}
+		const BB4 white = BB4::load(pawns[WHITE]), black = BB4::load(pawns[BLACK]);
+		find_masks<WHITE>(white, black, masks[WHITE]);
+		find_masks<BLACK>(black, white, masks[BLACK]);
+		for(int i = 0; i < k; i++){
+			Pawns::PawnEntry* e = &entries[base + i];
+			e->key = 0;
+			e->score = score_pawns<WHITE>(masks[WHITE], i, pawns[WHITE][i], pawns[BLACK][i], e)
+				- score_pawns<BLACK>(masks[BLACK], i, pawns[BLACK][i], pawns[WHITE][i], e);
+		}
+	}
+}
@@ -5,6 +5,11 @@
 #include "Bitboards.h"
 #include "Board.h"
 
+// Tables that '-tune' adjusts (see Tune.h) //
+extern Score Doubled[FILE_NB]; // doubled pawn penalty by [file]
+extern Score Isolated[2][FILE_NB]; // isolated pawn penalty by [opposed][file]
+extern Score Backward[2][FILE_NB]; // backward pawn penalty by [opposed][file]
+
 namespace Pawns {
 	struct PawnEntry {
 		// This contains information about a pawn structure. //
@@ -25,8 +30,11 @@ namespace Pawns {
 		// TODO: Use in Evaluation
 	};
 	
+	typedef HashTable<PawnEntry, 16384> PawnTable;
+	
 	void init(void);
 	PawnEntry* probe(const Board& pos);
+	void evaluate_batch(const PackedBoard* positions, size_t n, PawnEntry* entries); // fill in an entry for each position (not hashed, key left 0)
 }
 
 #endif // #ifndef PAWNS_INCLUDED
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+#include "MoveGen.h"
+#include "Threads.h"
+#include "Perft.h"
+#include <fstream>
+#include <sstream>
+
+void PerftTable::resize(size_t mbSize){
+	free(table);
+	table = NULL;
+	mask = 0;
+	if(!mbSize) return; // no hash
+	const size_t count = size_t(1) << msb((mbSize * 1024 * 1024) / sizeof(PerftEntry));
+	table = (PerftEntry*)calloc(count, sizeof(PerftEntry));
+	if(!table){
+		Error("Failed to allocate " + std::to_string(mbSize) + " MB for the perft hash.");
+	}
+	mask = count - 1;
+}
+
+void PerftTable::clear(void){
+	if(table) std::memset(table, 0, (mask + 1) * sizeof(PerftEntry));
+}
+
+inline size_t perft_index(Key key, Depth d, size_t mask){
+	// The same position at different depths should not fight over one slot. //
+	return size_t(key ^ (uint64_t(d) * 0x9E3779B97F4A7C15ULL)) & mask;
+}
+
+bool PerftTable::probe(Key key, Depth d, uint64_t& nodes) const {
+	const PerftEntry& e = table[perft_index(key, d, mask)];
+	const uint64_t data = e.data, k = e.key; // read once, another thread may be writing
+	if(((k ^ data) != key) || (Depth(data & 0xFF) != d)){
+		return false;
+	}
+	nodes = data >> 8;
+	return true;
+}
+
+void PerftTable::save(Key key, Depth d, uint64_t nodes){
+	PerftEntry& e = table[perft_index(key, d, mask)];
+	const uint64_t data = (nodes << 8) | uint64_t(d);
+	e.key = key ^ data;
+	e.data = data;
+}
+
+uint64_t Perft::perft(Board& pos, Depth depth, PerftTable* ptt){
+	assert(depth >= ONE_PLY);
+	uint64_t nodes;
+	if((depth > ONE_PLY) && ptt && ptt->probe(pos.key(), depth, nodes)){
+		return nodes;
+	}
+	ActMove moves[MAX_MOVES];
+	ActMove* const end = generate_moves<LEGAL>(pos, moves);
+	if(depth == ONE_PLY){
+		return end - moves; // bulk counting: everything generated is legal, so there's no need to make the moves
+	}
+	nodes = 0;
+	BoardState st;
+	CheckInfo ci(pos);
+	for(ActMove* it = moves; it != end; it++){
+		pos.do_move(it->move, st, pos.gives_check(it->move, ci));
+		nodes += perft(pos, depth - ONE_PLY, ptt);
+		pos.undo_move(it->move);
+	}
+	if(ptt) ptt->save(pos.key(), depth, nodes);
+	return nodes;
+}
+
+struct PerftWork {
+	// Shared by all of the perft threads: each one takes the next root move until there are none left. //
+	const Board* root;
+	std::vector<Move> moves;
+	std::vector<uint64_t> counts;
+	size_t next;
+	Mutex mutex;
+	Depth depth;
+	PerftTable* ptt;
+};
+
+void* perft_thread_func(void* arg){
+	PerftWork* w = (PerftWork*)arg;
+	Board pos;
+	pos = *w->root; // our own copy
+	CheckInfo ci(pos);
+	BoardState st;
+	while(true){
+		w->mutex.lock();
+		const size_t i = w->next++;
+		w->mutex.unlock();
+		if(i >= w->moves.size()) break;
+		const Move m = w->moves[i];
+		pos.do_move(m, st, pos.gives_check(m, ci));
+		w->counts[i] = (w->depth > ONE_PLY) ? Perft::perft(pos, w->depth - ONE_PLY, w->ptt) : 1;
+		pos.undo_move(m);
+	}
+	return NULL;
+}
+
+uint64_t Perft::run(const Board& pos, Depth depth, const Perft_Options& op, PerftTable& ptt){
+	assert(depth >= ONE_PLY);
+	PerftWork w;
+	w.root = &pos;
+	w.next = 0;
+	w.depth = depth;
+	w.ptt = ptt.enabled() ? &ptt : NULL;
+	for(MoveList<LEGAL> it(pos); *it; it++){
+		w.moves.push_back(*it);
+	}
+	w.counts.assign(w.moves.size(), 0);
+	// Split the root moves across the threads (no point in having more threads than moves). //
+	run_jobs(std::min(op.threads, w.moves.size()), perft_thread_func, &w);
+	uint64_t nodes = 0;
+	for(size_t i = 0; i < w.moves.size(); i++){
+		if(op.divide){
+			std::cout << Moves::format<false>(w.moves[i]) << ": " << w.counts[i] << std::endl;
+		}
+		nodes += w.counts[i];
+	}
+	return nodes;
+}
+
+bool Perft::run_suite(std::string fname, Depth max_depth, const Perft_Options& op){
+	// Each line is a FEN followed by the expected counts, e.g. "<fen> ;D1 20 ;D2 400". //
+	std::ifstream ifp(fname);
+	if(!ifp.is_open()){
+		Error("Could not open perft suite '" + fname + "' for reading.");
+	}
+	PerftTable ptt;
+	ptt.resize(op.hash);
+	std::string line;
+	int num = 0, failed = 0;
+	uint64_t total_nodes = 0;
+	int64_t total_time = 0;
+	while(std::getline(ifp, line)){
+		size_t semi = line.find(';');
+		std::string fen = line.substr(0, semi);
+		while(!fen.empty() && isspace(fen.back())) fen.pop_back();
+		if(fen.empty() || (fen[0] == '#')) continue; // blank line or comment
+		Board pos;
+		pos.init_from(fen);
+		++num;
+		while(semi != std::string::npos){
+			const size_t next = line.find(';', semi + 1);
+			std::istringstream ss(line.substr(semi + 1, next - semi - 1));
+			semi = next;
+			char c;
+			int d;
+			uint64_t expected;
+			if(!(ss >> c >> d >> expected) || (c != 'D') || (d < 1)) continue; // not a depth/count operation
+			if(Depth(d) > max_depth) continue;
+			const int64_t start = get_system_time_msec();
+			const uint64_t nodes = run(pos, Depth(d), op, ptt);
+			const int64_t elapsed = get_system_time_msec() - start;
+			total_nodes += nodes;
+			total_time += elapsed;
+			const bool ok = (nodes == expected);
+			failed += !ok;
+			printf("%3d D%d %14" PRIu64 " %s", num, d, nodes, ok ? "OK  " : "FAIL");
+			if(!ok) printf(" (expected %" PRIu64 ")", expected);
+			printf("  %s\n", fen.c_str());
+		}
+	}
+	printf("\n%d position(s), %d failure(s)\n", num, failed);
+	printf("Nodes: %" PRIu64 ", time: %" PRId64 " ms, %" PRIu64 " nodes/s\n", total_nodes, total_time, (total_nodes * 1000) / uint64_t(std::max(total_time, int64_t(1))));
+	return !failed;
+}
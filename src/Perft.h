@@ -0,0 +1,48 @@
+#ifndef PERFT_INC
+#define PERFT_INC
+
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+
+/*
+* A perft hash entry is 16 bytes:
+* key: 64 bits (XOR'ed with the data, so an entry torn by two threads writing at once just fails to match)
+* data: 56 bits of node count, 8 bits of depth
+*/
+
+struct PerftEntry {
+	uint64_t key; // Zobrist key ^ data
+	uint64_t data; // (nodes << 8) | depth
+};
+
+class PerftTable {
+	public:
+		static const int DefaultSize = 16; // in megabytes
+	private:
+		PerftEntry* table;
+		size_t mask; // entry count - 1 (always a power of 2)
+	public:
+		PerftTable(void) : table(NULL), mask(0) {}
+		~PerftTable(void){ free(table); }
+
+		void resize(size_t mbSize); // 0 turns the table off
+		void clear(void);
+		bool probe(Key key, Depth d, uint64_t& nodes) const; // lockless: safe to call from any number of threads
+		void save(Key key, Depth d, uint64_t nodes);
+		bool enabled(void) const { return table != NULL; }
+};
+
+struct Perft_Options {
+	size_t threads; // number of threads to split the root moves across
+	size_t hash; // perft hash size in megabytes (0 = no hash)
+	bool divide; // print the count for each root move
+};
+
+namespace Perft {
+	uint64_t perft(Board& pos, Depth depth, PerftTable* ptt = NULL); // single-threaded count (with bulk counting at the last ply)
+	uint64_t run(const Board& pos, Depth depth, const Perft_Options& op, PerftTable& ptt); // threaded perft from the root (prints each root move if dividing)
+	bool run_suite(std::string fname, Depth max_depth, const Perft_Options& op); // run an EPD perft suite (";D<depth> <count>" operations), returns false on any mismatch
+}
+
+#endif // #ifndef PERFT_INC
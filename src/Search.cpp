@@ -9,6 +9,8 @@
 #include "TimeManager.h"
 #include "UCI.h"
 #include "Book.h"
+#include "TT.h"
+#include "Tablebase.h"
 #include <cfloat>
 #include <cmath>
 
@@ -23,6 +25,7 @@ namespace Search {
 	RootMove LastBest(MOVE_NONE);
 	Book EngineBook("");
 	Book_Skill EngineBookSkill;
+	size_t MultiPV = 1;
 }
 
 // Search //
@@ -36,30 +39,59 @@ namespace {
 		NonPV // a non-PV node
 	};
 
-	HistoryTable History; // history table for use with move ordering
 	TimeManager TimeMgr; // our time manager
 	Value DrawValue[SIDE_NB]; // draw value by side
-	size_t PVIdx; // used for root nodes and PV lines
 	int FutilityMoveCounts[2][16]; // futility move counts by [improving][depth]
 	int8_t Reductions[2][2][64][64]; // reductions by [pv][improving][depth][move num.]
+	
+	// Helper threads skip some depths so that they don't all search the same //
+	// tree in lockstep: helper 'i' skips a depth if ((depth + ply + SkipPhase[i]) / SkipSize[i]) is odd.
+	const int SkipCount = 20;
+	const int SkipSize[SkipCount] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+	const int SkipPhase[SkipCount] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 }
 
 template<bool PvNode>
 inline Depth reduction(bool improving, Depth d, unsigned int move_num){
-	return Depth(Reductions[PvNode][improving][d][move_num]);
+	return Depth(Reductions[PvNode][improving][std::min(int(d), 63)][std::min(move_num, 63u)]);
 }
 
 inline Value futility_margin(Depth d){
 	return Value(200 * d);
 }
 
+inline Value razor_margin(Depth d){
+	return Value(512 + 32 * d);
+}
+
+inline void count_node(SearchThread* th, int ply){
+	++th->nodes;
+	th->max_ply = std::max(th->max_ply, ply);
+	// The main thread checks the node limit itself, since the timer would overshoot it. //
+	if(Limits.nodes && !(th->nodes & 1023) && (th == Threads.main_thread) && (Threads.nodes_searched() >= uint64_t(Limits.nodes))){
+		Signals.stop = true;
+	}
+}
+
+inline Value value_to_tt(Value v, int ply){
+	// Mate scores are stored relative to the current node rather than the root, //
+	// since the same position can be reached at a different ply.
+	assert(v != VAL_NONE);
+	return (v >= VAL_MATE_IN_MAX_PLY) ? (v + ply) : ((v <= VAL_MATED_IN_MAX_PLY) ? (v - ply) : v);
+}
+
+inline Value value_from_tt(Value v, int ply){
+	// The inverse of value_to_tt(). //
+	return (v == VAL_NONE) ? VAL_NONE : ((v >= VAL_MATE_IN_MAX_PLY) ? (v - ply) : ((v <= VAL_MATED_IN_MAX_PLY) ? (v + ply) : v));
+}
+
 template<NodeType NT>
 Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cut_node);
 
 template<NodeType NT, bool InCheck>
 Value qsearch(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth);
 
-void search_loop(Board& pos); // main iterative deepening loop
+bool probe_book(void); // play a book move at the root if/a
 
 void Search::init(void){
 	// Reductions Array //
@@ -81,36 +113,60 @@ void Search::init(void){
 	}
 }
 
-template<bool Root>
-uint64_t Search::perft(Board& pos, Depth depth){
-	assert(depth >= ONE_PLY);
-	// depth = depth left
+void Search::clear(void){
+	// Note: Must not be called while searching. //
+	TT.clear();
+	Threads.main_thread->clear();
+	Threads.main_thread->eval_cache.clear();
+	for(SearchThread* th : Threads.helpers){
+		th->clear();
+		th->eval_cache.clear();
+	}
+}
+
+void RootMove::insert_pv_in_tt(Board& pos){
+	// Makes sure the PV can be followed through the TT on the next iteration, even if //
+	// it was overwritten during the search.
+	BoardState states[MAX_PLY], *st = states;
+	bool found;
+	for(const Move& m : pv){
+		assert(MoveList<LEGAL>(pos).contains(m));
+		TTEntry* tte = TT.probe(pos.key(), found);
+		if(!found || tte->move() != m){
+			tte->save(pos.key(), VAL_NONE, BOUND_NONE, DEPTH_NONE, m, VAL_NONE, TT.generation());
+		}
+		pos.do_move(m, *st++);
+	}
+	for(size_t i = pv.size(); i > 0; ){
+		pos.undo_move(pv[--i]);
+	}
+}
+
+bool RootMove::extract_ponder_from_tt(Board& pos){
+	// If the search stopped before we got a ponder move, try to find one in the TT. //
 	BoardState st;
-	uint64_t nodes = 0, tmp;
-	const bool leaf = (depth == (2 * ONE_PLY)); // at that point, just use MoveList<LEGAL>.size()
-	for(MoveList<LEGAL> it(pos); *it; it++){
-		if(depth != ONE_PLY){
-			pos.do_move(*it, st);
-			tmp = (leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - ONE_PLY));
-			if(Root){
-				std::cout << Moves::format<false>(*it) << ": " << tmp << std::endl;
-			}
-			nodes += tmp;
-			pos.undo_move(*it);
-		} else {
-			++nodes;
+	bool found;
+	assert(pv.size() == 1);
+	if(pv[0] == MOVE_NONE) return false;
+	pos.do_move(pv[0], st);
+	TTEntry* tte = TT.probe(pos.key(), found);
+	if(found){
+		Move m = tte->move(); // could be some garbage from a hash collision
+		if(MoveList<LEGAL>(pos).contains(m)){
+			pv.push_back(m);
 		}
 	}
-	return nodes;
+	pos.undo_move(pv[0]);
+	return (pv.size() > 1);
 }
 
-template uint64_t Search::perft<true>(Board& pos, Depth depth); // explicit instantiation
-
 std::string uci_pv(const Board& pos, Depth depth, Value alpha, Value beta){
 	std::stringstream ss;
+	const RootMoveVector& RootMoves = pos.this_thread()->root_moves;
+	const size_t PVIdx = pos.this_thread()->PVIdx;
 	int64_t elapsed = get_system_time_msec() - SearchTime;
-	size_t PVLinesNum = 1; // TODO: Only 1 PV line for now
-	// TODO: SelDepth
+	uint64_t nodes = Threads.nodes_searched();
+	size_t PVLinesNum = std::min(MultiPV, RootMoves.size());
 	for(size_t i = 0; i < PVLinesNum; i++){
 		bool is_searched = (i <= PVIdx); // figure out if this one has been searched yet
 		if(!is_searched && (depth == ONE_PLY)) continue;
@@ -121,7 +177,7 @@ std::string uci_pv(const Board& pos, Depth depth, Value alpha, Value beta){
 			// returns chars available to read.
 			ss << "\n"; // we have written stuff before - just a hack to avoid using a boolean variable
 		}
-		ss << "info depth " << d << " seldepth " << Depth(d + 1) /* TODO */
+		ss << "info depth " << d << " seldepth " << std::max(int(d), pos.this_thread()->max_ply)
 		   << " multipv " << (i + 1) << " score " << UCI::value(v);
 		if(i == PVIdx){
 			// OK, we are called right now? Then it might be to report a failed aspiration
@@ -132,8 +188,8 @@ std::string uci_pv(const Board& pos, Depth depth, Value alpha, Value beta){
 				LastBest = RootMoves[0]; // otherwise, report this as the last stable line
 			}
 		}
-		ss << " nodes " << uint64_t(0) /* TODO */ 
-		   << " nps " << uint64_t(0) << " time " << elapsed << " pv";
+		ss << " nodes " << nodes << " tbhits " << Threads.tb_hits()
+		   << " nps " << (nodes * 1000 / std::max(elapsed, int64_t(1))) << " hashfull " << TT.hashfull() << " time " << elapsed << " pv";
 		for(size_t j = 0; j < RootMoves[i].pv.size(); j++){
 			ss << " " << UCI::move(RootMoves[i].pv[j]);
 		}
@@ -141,15 +197,8 @@ std::string uci_pv(const Board& pos, Depth depth, Value alpha, Value beta){
 	return ss.str();
 }		
 
-void search_loop(Board& pos){
-	Stack stack[MAX_PLY + 4], *ss = stack + 2; // for the fun (ss - 2) and (ss + 1)-type stuff
-	std::memset(ss - 2, 0, 5 * sizeof(Stack)); // get the first few down
-	Depth depth = DEPTH_ZERO; // what depth we are at right now
-	Value best_val, alpha, beta, delta; // best = best value so far, alpha & beta are search window, delta is aspiration window delta
-	best_val = alpha = delta = -VAL_INF;
-	beta = VAL_INF;
-	// TODO: TT.new_search();
-	History.clear();
+bool probe_book(void){
+	// Check if we have a book move that is good enough to be played right away. //
 	auto book_moves = EngineBook.results_for(RootPos);
 	if(book_moves.size()){
 		// Note: All moves returned by EngineBook.results_for(...) are guaranteed to be legal.
@@ -167,12 +216,39 @@ void search_loop(Board& pos){
 		Signals.stop = true;
 		std::cout << "info nodes " << uint64_t(0) << " time " << get_system_time_msec() - SearchTime << std::endl;
 	}
+	return Signals.stop;
+}
+
+void SearchThread::search_loop(void){
+	Board& pos = root_pos;
+	RootMoveVector& RootMoves = root_moves;
+	const bool is_main = (this == Threads.main_thread);
+	Stack stack[MAX_PLY + 4], *ss = stack + 2; // for the fun (ss - 2) and (ss + 1)-type stuff
+	std::memset(ss - 2, 0, 5 * sizeof(Stack)); // get the first few down
+	Depth depth = DEPTH_ZERO; // what depth we are at right now
+	Value best_val, alpha, beta, delta; // best = best value so far, alpha & beta are search window, delta is aspiration window delta
+	best_val = alpha = delta = -VAL_INF;
+	beta = VAL_INF;
+	completed_depth = DEPTH_ZERO;
+	// Keep what we learned in the last search, but let it fade. //
+	history.age();
+	for(Piece pc = NO_PIECE; pc < PIECE_NB; pc++){
+		for(Square s = SQ_A1; s <= SQ_H8; s++){
+			cont_history[pc][s].age();
+		}
+	}
 	while((++depth < DEPTH_MAX) && !Signals.stop && (!Limits.depth || (depth <= Limits.depth))){
+		if(!is_main){
+			// Helpers skip some of the depths. //
+			const int i = (idx - 1) % SkipCount;
+			if(((depth + pos.get_ply() + SkipPhase[i]) / SkipSize[i]) % 2){
+				continue;
+			}
+		}
 		for(size_t i = 0; i < RootMoves.size(); i++){
 			RootMoves[i].prev_score = RootMoves[i].score; // save scores from last iteration
 		}
-		size_t PVLinesNum = 1; // TODO
-		PVLinesNum = std::min(PVLinesNum, RootMoves.size());
+		const size_t PVLinesNum = std::min(MultiPV, RootMoves.size());
 		for(PVIdx = 0; (PVIdx < PVLinesNum && !Signals.stop); PVIdx++){
 			if(depth >= (5 * ONE_PLY)){
 				delta = Value(16); // reset delta
@@ -186,8 +262,13 @@ void search_loop(Board& pos){
 			while(true){ // Aspiration window loop
 				best_val = search<Root>(pos, ss, alpha, beta, depth, false); // false = isCutNode
 				std::stable_sort(RootMoves.begin() + PVIdx, RootMoves.end()); // bring the new best move to the front
-				for(size_t i = 0; i < RootMoves.size(); i++){
-					RootMoves[i].insert_pv_in_tt(pos);
+				if(is_main){
+					// Only the lines searched so far have a PV worth keeping (and the helpers' would overwrite ours). //
+					// A line that ends in the tables is carried on from them, so the PV and the ponder move don't stop there.
+					for(size_t i = 0; i <= PVIdx; i++){
+						Tablebases::extend_pv(pos, RootMoves[i].pv);
+						RootMoves[i].insert_pv_in_tt(pos);
+					}
 				}
 				if(Signals.stop){
 					/*
@@ -208,10 +289,15 @@ void search_loop(Board& pos){
 						}
 					}
 					*/
+					// This line and the ones after it were not finished, so their scores are partial (or -VAL_INF): //
+					// use the ones from the last completed depth, as uci_pv() does for unsearched lines.
+					for(size_t i = PVIdx; i < RootMoves.size(); i++){
+						RootMoves[i].score = RootMoves[i].prev_score;
+					}
 					break; // stop - no time or told to stop
 				}
 				last_was_fail_low = false;
-				if(PVLinesNum == 1 && (best_val <= alpha || best_val >= beta) && (get_system_time_msec() - 3000 > SearchTime)){
+				if(is_main && PVLinesNum == 1 && (best_val <= alpha || best_val >= beta) && (get_system_time_msec() - 3000 > SearchTime)){
 					// Give UCI update when failing high/low (e.g. lowerbound/upperbound). //
 					std::cout << uci_pv(pos, depth, alpha, beta) << std::endl;
 				}
@@ -224,8 +310,10 @@ void search_loop(Board& pos){
 					// management know that we did fail low at root and get a better window.
 					beta = (alpha + beta) / 2; // it seems like beta is working out, so let's push our luck a little
 					alpha = std::max(best_val - delta, -VAL_INF); // decrease alpha
-					Signals.failed_low_at_root = true; // we did after all
-					Signals.stop_on_ponder_hit = false; // we need to complete this first
+					if(is_main){
+						Signals.failed_low_at_root = true; // we did after all
+						Signals.stop_on_ponder_hit = false; // we need to complete this first
+					}
 				} else if(best_val >= beta){
 					// Failed high. //
 					alpha = (alpha + beta) / 2; // push our luck with alpha
@@ -238,9 +326,10 @@ void search_loop(Board& pos){
 				assert((alpha >= -VAL_INF) && (beta <= VAL_INF)); // just make sure
 			}
 			std::stable_sort(RootMoves.begin(), RootMoves.begin() + PVIdx + 1); // sort the lines that we have *already* searched so far
-			if(Signals.stop){
-				// TODO: Fully implement node count
-				std::cout << "info nodes " << uint64_t(0) /* TODO */ << " time " << get_system_time_msec() - SearchTime << std::endl;
+			if(!is_main){
+				continue; // only the main thread reports
+			} else if(Signals.stop){
+				std::cout << "info nodes " << Threads.nodes_searched() << " time " << get_system_time_msec() - SearchTime << std::endl;
 			} else if((PVIdx + 1 == PVLinesNum) || (get_system_time_msec() - 3000 > SearchTime)){
 				// We display the PV for root only if we have just finished an entire root
 				// PV line or it has already been more than 3 seconds since the 
@@ -248,6 +337,12 @@ void search_loop(Board& pos){
 				std::cout << uci_pv(pos, depth, alpha, beta) << std::endl;
 			}
 		}
+		if(!Signals.stop){
+			completed_depth = depth;
+		}
+		if(!is_main){
+			continue; // only the main thread decides when to stop
+		}
 		if(Limits.mate && (best_val >= VAL_MATE_IN_MAX_PLY) && ((VAL_MATE - best_val) <= (2 * Limits.mate))){
 			Signals.stop = true; // we have completed the mate search and found the mate in the specified number of moves
 		}
@@ -269,7 +364,15 @@ void update_pv(Move* pv, Move move, Move* child_pv){
 	*pv = MOVE_NONE; // stop it right here
 }
 
-uint64_t failed_high_total, failed_high_first, failed_high_second; // for measuring move ordering
+void update_quiet_stats(HistoryTable& hst, Stack* ss, const Board& pos, Move m, Value bonus){
+	// Updates the history and the continuation histories of the previous two moves. //
+	const Piece pc = pos.moved_piece(m);
+	const Square to = to_sq(m);
+	hst.register_update(pc, to, bonus);
+	if((ss - 1)->cont_history) (ss - 1)->cont_history->register_update(pc, to, bonus);
+	if((ss - 2)->cont_history) (ss - 2)->cont_history->register_update(pc, to, bonus);
+}
+
 
 template<NodeType NT>
 Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cut_node){
@@ -278,6 +381,7 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 	assert((-VAL_INF <= alpha) && (alpha < beta) && (beta <= VAL_INF));
 	assert(PvNode || (alpha == (beta - 1))); // either this is a PV node or some zero window searches are being done
 	BoardState st; // a BoardState we use for doing moves
+	SearchThread* this_thread = pos.this_thread();
 	const bool in_check = pos.checkers();
 	assert(depth > DEPTH_ZERO);
 	const Value old_alpha = alpha;
@@ -287,23 +391,84 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 	assert(0 <= ss->ply && ss->ply < MAX_PLY);
 	(ss+1)->skip_early_pruning = false;
 	(ss+1)->reduction = DEPTH_ZERO;
+	(ss+2)->killers[0] = (ss+2)->killers[1] = MOVE_NONE;
+	count_node(this_thread, ss->ply);
 	if(!RootNode){
-		if(Signals.stop || pos.is_draw() || (ss->ply >= MAX_PLY)){
+		if(Signals.stop || pos.is_draw(ss->ply - 1) || (ss->ply >= MAX_PLY)){
 			return (ss->ply >= MAX_PLY && !in_check) ? Eval::evaluate(pos) : DrawValue[pos.side_to_move()];
 		}
+		// Upcoming Repetition //
+		// If we can repeat an earlier position, we can at least get a draw, so raise alpha before searching anything.
+		if((alpha < DrawValue[pos.side_to_move()]) && pos.has_game_cycle(ss->ply - 1)){ // the root is at ply 1
+			alpha = DrawValue[pos.side_to_move()];
+			if(alpha >= beta) return alpha;
+		}
 		// Mate Distance Pruning //
 		alpha = std::max(alpha, mated_in(ss->ply));
 		beta = std::min(mate_in(ss->ply + 1), beta);
 		if(alpha >= beta) return alpha;
 	}
-	ss->static_eval = VAL_NONE;
-	/*
+	// Transposition Table Lookup //
+	const Key pos_key = pos.key();
+	bool tt_hit;
+	TTEntry* tte = TT.probe(pos_key, tt_hit);
+	const Value tt_value = tt_hit ? value_from_tt(tte->value(), ss->ply) : VAL_NONE;
+	Move tt_move = RootNode ? this_thread->root_moves[this_thread->PVIdx].pv[0] : (tt_hit ? tte->move() : MOVE_NONE);
+	if(!PvNode && tt_hit && (tte->depth() >= depth) && (tt_value != VAL_NONE) 
+	   && ((tt_value >= beta) ? (tte->bound() & BOUND_LOWER) : (tte->bound() & BOUND_UPPER))){
+		// We have already searched this deep enough, and the bound is good enough to return. //
+		ss->current_move = tte->move(); // can be MOVE_NONE
+		return tt_value;
+	}
+	// Tablebase Probe //
+	if(!RootNode && Tablebases::Cardinality && (popcount<Full>(pos.all()) <= Tablebases::Cardinality)){
+		int wdl, plies;
+		// A mate that the 50 move rule would turn into a draw isn't one, so leave it to the search //
+		// (and probe() already refuses positions with castling rights).
+		if(Tablebases::probe(pos, wdl, plies) && (!wdl || (pos.state()->fifty_ct + plies <= 100))){
+			this_thread->tb_hits++;
+			// The distance is exact, so the result is as good as a search of any depth. //
+			const Value v = (wdl > 0) ? ((ss->ply + plies < MAX_PLY) ? mate_in(ss->ply + plies) : VAL_MATE_IN_MAX_PLY - 1)
+						  : ((wdl < 0) ? ((ss->ply + plies < MAX_PLY) ? mated_in(ss->ply + plies) : -VAL_MATE_IN_MAX_PLY + 1)
+						  : DrawValue[pos.side_to_move()]);
+			tte->save(pos_key, value_to_tt(v, ss->ply), BOUND_EXACT, std::min(DEPTH_MAX - ONE_PLY, depth + 6 * ONE_PLY), MOVE_NONE, VAL_NONE, TT.generation());
+			return v;
+		}
+	}
+	// Static Evaluation //
+	Value eval = ss->static_eval = VAL_NONE;
+	if(!in_check){
+		if(tt_hit){
+			// Saves us an evaluation if it was stored. //
+			if((ss->static_eval = eval = tte->eval()) == VAL_NONE){
+				ss->static_eval = eval = Eval::evaluate(pos);
+			}
+			// And the TT score is a better estimate if the bound allows it. //
+			if((tt_value != VAL_NONE) && (tte->bound() & ((tt_value > eval) ? BOUND_LOWER : BOUND_UPPER))){
+				eval = tt_value;
+			}
+		} else {
+			ss->static_eval = eval = ((ss - 1)->current_move != MOVE_NULL) ? Eval::evaluate(pos) : -(ss - 1)->static_eval; // TODO: Tempo add
+			tte->save(pos_key, VAL_NONE, BOUND_NONE, DEPTH_NONE, MOVE_NONE, ss->static_eval, TT.generation());
+		}
+	}
 	if(!in_check && !ss->skip_early_pruning){
 		// Now let's try to prune as much as possible before entering the main move loop. //
-		Value eval = ss->static_eval = ((ss - 1)->current_move != MOVE_NULL) ? Eval::evaluate(pos) : -(ss - 1)->static_eval; // TODO: Tempo add
 		Side to_move = pos.side_to_move();
 		const bool np_material = pos.pieces(to_move) & ~(pos.pieces(PAWN) | pos.pieces(KING)); // if the side to move has any non-pawn material or not
-		// TODO: Razoring
+		// Razoring //
+		if(!PvNode && (depth < 4 * ONE_PLY) && (eval + razor_margin(depth) <= alpha) && (tt_move == MOVE_NONE)
+		   && !(pos.pieces(to_move, PAWN) & rank_bb(relative_rank(to_move, RANK_7)))){
+			// We are so far below alpha that only captures can save us, so let QS decide. //
+			if((depth <= ONE_PLY) && (eval + razor_margin(3 * ONE_PLY) <= alpha)){
+				return qsearch<NonPV, false>(pos, ss, alpha, beta, DEPTH_ZERO);
+			}
+			const Value ralpha = alpha - razor_margin(depth);
+			const Value v = qsearch<NonPV, false>(pos, ss, ralpha, ralpha + 1, DEPTH_ZERO);
+			if(v <= ralpha){
+				return v;
+			}
+		}
 		// Futility Pruning (Child Node) //
 		if(!RootNode && (depth < 7 * ONE_PLY) && (eval - futility_margin(depth) >= beta) && (eval < VAL_KNOWN_WIN) && np_material){
 			// OK, this node can't and likely won't do much - it is futile to search it.
@@ -311,26 +476,76 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 		}
 		// Verified Null Move Pruning //
 		if(!PvNode && (depth >= 2 * ONE_PLY) && (eval >= beta) && np_material){
+			// If we can pass and still be above beta, then a real move will almost always be too. //
 			ss->current_move = MOVE_NULL; // a null move - literally
-			// TODO
+			ss->cont_history = NULL;
+			Depth R = Depth(((823 + 67 * int(depth)) / 256 + std::min(int(eval - beta) / PawnValueMg, 3)) * ONE_PLY);
+			pos.do_null_move(st);
+			(ss + 1)->skip_early_pruning = true; // no two null moves in a row
+			Value null_value = (depth - R < ONE_PLY) ? -qsearch<NonPV, false>(pos, (ss + 1), -beta, -(beta - 1), DEPTH_ZERO)
+													 : -search<NonPV>(pos, (ss + 1), -beta, -(beta - 1), depth - R, !cut_node);
+			(ss + 1)->skip_early_pruning = false;
+			pos.undo_null_move();
+			if(null_value >= beta){
+				if(null_value >= VAL_MATE_IN_MAX_PLY){
+					null_value = beta; // a mate found after passing isn't a proven one
+				}
+				if((depth < 12 * ONE_PLY) && (abs(beta) < VAL_KNOWN_WIN)){
+					return null_value;
+				}
+				// At high depths, verify with a reduced search without null moves so zugzwang doesn't fool us. //
+				ss->skip_early_pruning = true;
+				Value v = (depth - R < ONE_PLY) ? qsearch<NonPV, false>(pos, ss, beta - 1, beta, DEPTH_ZERO)
+												: search<NonPV>(pos, ss, beta - 1, beta, depth - R, false);
+				ss->skip_early_pruning = false;
+				if(v >= beta){
+					return null_value;
+				}
+			}
 		}
 		// ProbCut //
 		if(!PvNode && (depth >= 5 * ONE_PLY) && (abs(beta) < VAL_MATE_IN_MAX_PLY)){
-			// TODO: Implement in MoveSorter
+			// If a good capture beats beta by a margin at a reduced depth, the full //
+			// search will almost certainly fail high as well.
+			const Value rbeta = std::min(beta + 200, VAL_INF);
+			const Depth rdepth = depth - 4 * ONE_PLY;
+			MoveSorter mp(pos, tt_move, this_thread->history, rbeta - ss->static_eval);
+			Move m;
+			while((m = mp.next_move()) != MOVE_NONE){
+				ss->current_move = m;
+				ss->cont_history = &this_thread->cont_history[pos.moved_piece(m)][to_sq(m)];
+				pos.do_move(m, st);
+				const Value v = -search<NonPV>(pos, (ss + 1), -rbeta, -(rbeta - 1), rdepth, !cut_node);
+				pos.undo_move(m);
+				if(v >= rbeta){
+					return v;
+				}
+			}
 		}
-		// TODO: IID
 	}
-	*/
+	// Internal Iterative Deepening //
+	if(!RootNode && (tt_move == MOVE_NONE) && (depth >= (PvNode ? 5 * ONE_PLY : 8 * ONE_PLY)) && (PvNode || in_check || (ss->static_eval + 256 >= beta))){
+		// No move to try first, so find one with a shallower search. //
+		const Depth d = depth - 2 * ONE_PLY - (PvNode ? DEPTH_ZERO : depth / 4);
+		ss->skip_early_pruning = true;
+		search<PvNode ? PV : NonPV>(pos, ss, alpha, beta, d, true);
+		ss->skip_early_pruning = false;
+		tte = TT.probe(pos_key, tt_hit);
+		tt_move = tt_hit ? tte->move() : MOVE_NONE;
+	}
 	// Main Move Loop //
-	MoveSorter mi(pos, depth, History, ss);
-	Move m = MOVE_NULL;
+	const Square prev_sq = to_sq((ss - 1)->current_move);
+	const Move counter_move = is_ok((ss - 1)->current_move) ? this_thread->counter_moves[pos.at(prev_sq)][prev_sq] : MOVE_NONE;
+	MoveSorter mi(pos, tt_move, depth, this_thread->history, counter_move, ss);
+	Move m = MOVE_NULL, best_move = MOVE_NONE;
 	Value score, best_score = -VAL_INF;
-	const Bitboard pinned = pos.pinned(pos.side_to_move());
 	const bool improving = (ss->static_eval >= (ss - 2)->static_eval) || (ss->static_eval == VAL_NONE) || ((ss - 2)->static_eval == VAL_NONE);
 	unsigned int move_num = 0; // number of valid moves searched
+	Move quiets_searched[64]; // for history penalties
+	int quiet_ct = 0;
 	CheckInfo ci(pos);
 	while((m = mi.next_move()) != MOVE_NONE){
-		if(RootNode && !std::count(RootMoves.begin() + PVIdx, RootMoves.end(), m)){
+		if(RootNode && !std::count(this_thread->root_moves.begin() + this_thread->PVIdx, this_thread->root_moves.end(), m)){
 			// At the root, the moves to search are already filled in by 
 			// Threads.start_searching(), so we can check if this is
 			// in that vector for a legality check.
@@ -338,7 +553,7 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 			continue;
 		}
 		++move_num;
-		if(RootNode){
+		if(RootNode && (this_thread == Threads.main_thread)){
 			Signals.first_root_move = (move_num == 1);
 			if(get_system_time_msec() - 3000 > SearchTime){
 				std::cout << "info depth " << (depth / ONE_PLY) << " currmove " << UCI::move(m) << " currmovenumber " << move_num << std::endl;
@@ -352,7 +567,7 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 		bool gives_check = (type_of(m) == NORMAL && !pos.lined(pos.side_to_move())) ? (ci.kattk[type_of(pos.at(from_sq(m)))] & to_sq(m)) : pos.gives_check(m, ci);
 		bool dangerous = gives_check || (type_of(m) != NORMAL) || (type_of(pos.moved_piece(m)) == PAWN);
 		// Checking Extension //
-		if(gives_check && (pos.see_sign(m) >= VAL_ZERO)){
+		if(gives_check && pos.see_ge(m)){
 			extension = ONE_PLY;
 		}
 		Depth new_depth = depth - ONE_PLY + extension;
@@ -360,33 +575,44 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 		// Shallow Pruning //
 		if(!RootNode && !PvNode && move_num && !cap_or_prom && !in_check && !dangerous && (best_score > VAL_MATED_IN_MAX_PLY)){
 			// OK, if it really won't hurt most likely, let's bite. //
-			// TODO: Move count based pruning
-			// TODO: Futility pruning for parent node
-			likely_depth = new_depth - reduction<PvNode>(improving, depth, move_num); // TODO: improving = true for now
+			// Move Count Based Pruning //
+			if((depth < 16 * ONE_PLY) && (move_num >= unsigned(FutilityMoveCounts[improving][depth]))){
+				continue; // this late, a quiet move is very unlikely to do anything
+			}
+			likely_depth = new_depth - reduction<PvNode>(improving, depth, move_num);
+			// Futility Pruning (Parent Node) //
+			if(likely_depth < 7 * ONE_PLY){
+				const Value futility_value = ss->static_eval + futility_margin(likely_depth) + 256;
+				if(futility_value <= alpha){
+					best_score = std::max(best_score, futility_value);
+					continue;
+				}
+			}
 			// SEE-Based Pruning //
-			if((likely_depth < 4 * ONE_PLY) && (pos.see_sign(m) < VAL_ZERO)){
+			if((likely_depth < 4 * ONE_PLY) && !pos.see_ge(m)){
 				continue; // skip this move
 			}
 		}
 		// TODO: Extensions, Reductions
-		if(!RootNode && !pos.legal(m, pinned)){
-			// If illegal, skip it (late so we might get a change to prune this). //
-			--move_num;
-			continue;
-		}
 		ss->current_move = m; // set the current move
+		ss->cont_history = &this_thread->cont_history[pos.moved_piece(m)][to_sq(m)];
+		if(!cap_or_prom && (quiet_ct < 64)){
+			quiets_searched[quiet_ct++] = m;
+		}
+		const Value hist_score = cap_or_prom ? VAL_ZERO : quiet_score(this_thread->history, ss, pos.moved_piece(m), to_sq(m));
 		// Do Move //
-		pos.do_move(m, st);
+		pos.do_move(m, st, gives_check);
 		bool do_full_depth_search;
 		// LMR //
 		if((depth >= 3 * ONE_PLY) && (move_num > 1) && !cap_or_prom){
 			ss->reduction = reduction<PvNode>(improving, depth, move_num);
-			// Increase reduction if it has a bad history value or it is a cut node. //
-			if((!PvNode && cut_node) || (History[pos.at(to_sq(m))][to_sq(m)])){
+			// Reduce cut nodes one more ply, and quiet moves unless their combined history (which is within +/- 3 * Max) //
+			// is very good: that still takes the extra ply off nearly every quiet move, which searches much faster.
+			if((!PvNode && cut_node) || (hist_score < HistoryTable::Max)){
 				ss->reduction += ONE_PLY;
 			}
 			// If this evades a capture, don't reduce it as much. //
-			if((ss->reduction != DEPTH_ZERO) && (type_of(m) == NORMAL) && (type_of(pos.at(to_sq(m))) != PAWN) && (pos.see(make_move(to_sq(m), from_sq(m))) < VAL_ZERO)){
+			if((ss->reduction != DEPTH_ZERO) && (type_of(m) == NORMAL) && (type_of(pos.at(to_sq(m))) != PAWN) && !pos.see_ge(make_move(to_sq(m), from_sq(m)))){
 				ss->reduction = std::max(DEPTH_ZERO, ss->reduction - ONE_PLY);
 			}
 			Depth d = std::max(new_depth - ss->reduction, ONE_PLY);
@@ -427,7 +653,7 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 		}
 		if(RootNode){
 			// If we are at the root, we have to keep the RootMove stuff updated, including PV's. //
-			RootMove& rm = *std::find(RootMoves.begin(), RootMoves.end(), m);
+			RootMove& rm = *std::find(this_thread->root_moves.begin(), this_thread->root_moves.end(), m);
 			if(move_num == 1 || score > alpha){ // either this is the first move or it is the new best move
 				rm.score = score;
 				rm.pv.resize(1);
@@ -442,6 +668,7 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 		if(score > best_score){
 			best_score = score;
 			if(score > alpha){
+				best_move = m;
 				// We only update alpha if it is a PV node. //
 				if(PvNode && !RootNode){
 					// If this is a PV node not at the root, record its best move in the PV of its child as well. //
@@ -458,18 +685,33 @@ Value search(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool c
 	}
 	if(!move_num){
 		// No valid moves at this position, so we must be in either checkmate or stalemate. //
-		if(pos.checkers()) return mated_in(ss->ply);
-		else return DrawValue[pos.side_to_move()];
-	}
-	if(best_score >= beta && !in_check && !pos.is_capture(m) && (type_of(m) != PROMOTION)){
-		// TODO: Penalty for all quiet moves that didn't do anything
-		const Value bonus = Value(int(depth) * int(depth));
-		History.register_update(pos.moved_piece(m), to_sq(m), bonus);
-		if(move_num == 1) ++failed_high_first;
-		else if(move_num == 2) ++failed_high_second;
-		++failed_high_total;
+		best_score = in_check ? mated_in(ss->ply) : DrawValue[pos.side_to_move()];
+	} else if(best_score >= beta && !in_check && !pos.is_capture(best_move) && (type_of(best_move) != PROMOTION)){
+		// Reward the move that caused the cutoff, and penalize the quiets that didn't. //
+		const int d = std::min(int(depth), 17);
+		const Value bonus = Value(d * d + 2 * d - 2);
+		update_quiet_stats(this_thread->history, ss, pos, best_move, bonus);
+		for(int i = 0; i < quiet_ct; i++){
+			if(quiets_searched[i] != best_move){
+				update_quiet_stats(this_thread->history, ss, pos, quiets_searched[i], -bonus);
+			}
+		}
+		if(ss->killers[0] != best_move){
+			ss->killers[1] = ss->killers[0];
+			ss->killers[0] = best_move;
+		}
+		if(is_ok((ss - 1)->current_move)){
+			this_thread->counter_moves.update(pos.at(prev_sq), prev_sq, best_move);
+		}
+		if(move_num == 1) ++this_thread->cutoffs_first;
+		else if(move_num == 2) ++this_thread->cutoffs_second;
+		++this_thread->cutoffs;
 	}
 	assert(best_score > -VAL_INF);
+	// Transposition Table Save //
+	tte->save(pos_key, value_to_tt(best_score, ss->ply), 
+			  (best_score >= beta) ? BOUND_LOWER : ((PvNode && (best_score > old_alpha) && best_move) ? BOUND_EXACT : BOUND_UPPER), 
+			  depth, best_move, ss->static_eval, TT.generation());
 	return best_score;
 }
 
@@ -485,51 +727,78 @@ Value qsearch(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth){
 	Move pv[MAX_PLY + 1]; // for giving the PV to children
 	Move best_move, m;
 	BoardState st;
-	Value best_score, old_alpha, score;
+	Value best_score, score;
+	const Value old_alpha = alpha; // for TT reference
 	if(PvNode){
-		old_alpha = alpha; // for TT reference
 		(ss + 1)->pv = pv; // give child a PV
 		ss->pv[0] = MOVE_NONE; // reset our own PV (since we can't rely on search() to do it for us necessarily)
 	}
 	ss->current_move = best_move = MOVE_NONE;
 	ss->ply = (ss - 1)->ply + 1;
+	count_node(pos.this_thread(), ss->ply);
 	// Check for draws, going over maximum ply. //
-	if(pos.is_draw() || (ss->ply >= MAX_PLY)){
+	if(pos.is_draw(ss->ply - 1) || (ss->ply >= MAX_PLY)){
 		return (ss->ply >= MAX_PLY && !InCheck) ? (Eval::evaluate(pos)) : (DrawValue[pos.side_to_move()]);
 	}
 	assert((0 <= ss->ply) && (ss->ply < MAX_PLY));
-	// TODO: TT Lookup
+	// Upcoming Repetition //
+	if((alpha < DrawValue[pos.side_to_move()]) && pos.has_game_cycle(ss->ply - 1)){
+		alpha = DrawValue[pos.side_to_move()];
+		if(alpha >= beta) return alpha;
+	}
+	// Transposition Table Lookup //
+	// Note: QS only really has two depths as far as the TT is concerned - with and without checks.
+	const Depth tt_depth = (InCheck || (depth >= DEPTH_QS_CHECKS)) ? DEPTH_QS_CHECKS : DEPTH_QS_NO_CHECKS;
+	const Key pos_key = pos.key();
+	bool tt_hit;
+	TTEntry* tte = TT.probe(pos_key, tt_hit);
+	const Value tt_value = tt_hit ? value_from_tt(tte->value(), ss->ply) : VAL_NONE;
+	if(!PvNode && tt_hit && (tte->depth() >= tt_depth) && (tt_value != VAL_NONE)
+	   && ((tt_value >= beta) ? (tte->bound() & BOUND_LOWER) : (tte->bound() & BOUND_UPPER))){
+		ss->current_move = tte->move(); // can be MOVE_NONE
+		return tt_value;
+	}
 	// TODO: Futility base
+	bool lazy_eval = false; // a lazy evaluation is only good enough for this node, so it never goes to the TT
 	if(InCheck){
 		ss->static_eval = VAL_NONE;
 		best_score = -VAL_INF;
 	} else {
-		ss->static_eval = best_score = ((ss - 1)->current_move != MOVE_NULL) ? (Eval::evaluate(pos)) : (-(ss - 1)->static_eval); // TODO: Add Eval::Tempo
+		if(tt_hit){
+			// Saves us an evaluation if it was stored. //
+			if((ss->static_eval = best_score = tte->eval()) == VAL_NONE){
+				ss->static_eval = best_score = Eval::evaluate(pos, alpha, beta, lazy_eval);
+			}
+			// And the TT score can be used as a better stand pat if the bound allows it. //
+			if((tt_value != VAL_NONE) && (tte->bound() & ((tt_value > best_score) ? BOUND_LOWER : BOUND_UPPER))){
+				best_score = tt_value;
+			}
+		} else {
+			ss->static_eval = best_score = ((ss - 1)->current_move != MOVE_NULL) ? (Eval::evaluate(pos, alpha, beta, lazy_eval)) : (-(ss - 1)->static_eval); // TODO: Add Eval::Tempo
+		}
 		// Stand pat if possible. //
 		if(best_score >= beta){
-			// TODO: Save to TT
+			if(!tt_hit){
+				tte->save(pos_key, value_to_tt(best_score, ss->ply), BOUND_LOWER, DEPTH_NONE, MOVE_NONE, lazy_eval ? VAL_NONE : ss->static_eval, TT.generation());
+			}
 			return best_score;
 		}
 		if(PvNode && (best_score > alpha)){
 			alpha = best_score;
 		}
 	}
-	MoveSorter mp(pos, depth, History, to_sq((ss - 1)->current_move)); // const Board& p, Depth d, const HistoryTable& ht, Square s
+	MoveSorter mp(pos, tt_hit ? tte->move() : MOVE_NONE, depth, pos.this_thread()->history, to_sq((ss - 1)->current_move));
 	CheckInfo ci(pos);
-	const Bitboard pinned = pos.pinned(pos.side_to_move());
 	while((m = mp.next_move()) != MOVE_NONE){
 		assert(is_ok(m));
 		bool gives_check = (type_of(m) == NORMAL && !pos.lined(pos.side_to_move())) ? (ci.kattk[type_of(pos.at(from_sq(m)))] & to_sq(m)) : pos.gives_check(m, ci);
 		// TODO: Futility pruning with Futility Base
 		bool is_prunable_evasion = InCheck && (best_score > VAL_MATED_IN_MAX_PLY) && !pos.is_capture(m) && !pos.can_castle(CastlingRight((WHITE_OO | WHITE_OOO) << (2 * pos.side_to_move())));
-		if((!InCheck || is_prunable_evasion) && (type_of(m) != PROMOTION) && (pos.see_sign(m) < VAL_ZERO)){
+		if((!InCheck || is_prunable_evasion) && (type_of(m) != PROMOTION) && !pos.see_ge(m)){
 			continue; // avoid losing captures (unless in check)
 		}
-		if(!pos.legal(m, pinned)){
-			continue; // illegal move
-		}
 		ss->current_move = m; // set current move
-		pos.do_move(m, st);
+		pos.do_move(m, st, gives_check);
 		score = gives_check ? (-qsearch<NT, true>(pos, (ss + 1), -beta, -alpha, (depth - ONE_PLY))) : (-qsearch<NT, false>(pos, (ss + 1), -beta, -alpha, (depth - ONE_PLY)));
 		pos.undo_move(m);
 		assert((score > -VAL_INF) && (score < VAL_INF));
@@ -544,7 +813,7 @@ Value qsearch(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth){
 					best_move = m;
 				} else {
 					// Fail-high. //
-					// TODO: TT Save
+					tte->save(pos_key, value_to_tt(score, ss->ply), BOUND_LOWER, tt_depth, m, lazy_eval ? VAL_NONE : ss->static_eval, TT.generation());
 					return score;
 				}
 			}
@@ -555,40 +824,91 @@ Value qsearch(Board& pos, Stack* ss, Value alpha, Value beta, Depth depth){
 		// TODO: Verify that this was not the result of pruning moves
 		return mated_in(ss->ply);
 	}
-	// TODO: TT Save
+	tte->save(pos_key, value_to_tt(best_score, ss->ply), (PvNode && (best_score > old_alpha)) ? BOUND_EXACT : BOUND_UPPER, 
+			  tt_depth, best_move, lazy_eval ? VAL_NONE : ss->static_eval, TT.generation());
 	return best_score;
 }
 
+Value Search::quiesce(Board& pos, std::vector<Move>& pv){
+	assert(pos.this_thread());
+	Stack stack[MAX_PLY + 4], *ss = stack + 2;
+	Move line[MAX_PLY + 1];
+	std::memset(ss - 2, 0, 5 * sizeof(Stack));
+	ss->pv = line;
+	const Value v = pos.checkers() ? qsearch<PV, true>(pos, ss, -VAL_INF, VAL_INF, DEPTH_ZERO)
+		: qsearch<PV, false>(pos, ss, -VAL_INF, VAL_INF, DEPTH_ZERO);
+	pv.clear();
+	for(Move* m = line; *m != MOVE_NONE; m++){
+		pv.push_back(*m);
+	}
+	return v;
+}
+
 void Search::think(void){
 	// This is the externally available way to launch a search. //
 	// Note: The SearchLimits, SearchTime, etc. should already
 	// be correctly initialized and set to the values provided
 	// by the GUI.
-	failed_high_total = failed_high_first = failed_high_second = 0;
 	Side to_move = RootPos.side_to_move();
 	TimeMgr.init(Limits, to_move, RootPos.get_ply());
 	Value contempt = VAL_ZERO; // TODO: Base this on game phase
 	DrawValue[to_move] = VAL_DRAW - contempt;
 	DrawValue[~to_move] = VAL_DRAW + contempt;
+	bool searched = false;
 	if(RootMoves.empty()){
 		// Ummm... what? No moves available? We're in trouble...
 		std::cout << "info depth 0 score " << UCI::value(RootPos.checkers() ? VAL_MATE : VAL_DRAW) << std::endl;
-	} else {
+	} else if(!probe_book()){
+		SearchThread* main_thread = Threads.main_thread;
+		main_thread->root_pos = RootPos;
+		main_thread->root_pos.set_thread(main_thread);
+		main_thread->root_moves = RootMoves;
+		TT.new_search(); // older entries are replaced first from now on
 		Threads.timer->run = true;
 		Threads.timer->notify_one();
-		search_loop(RootPos);
+		Threads.start_helpers();
+		main_thread->search_loop();
 		Threads.timer->run = false; // stop the timer
+		searched = true;
 	}
 	if(!Signals.stop && (Limits.ponder || Limits.infinite)){
 		Signals.stop_on_ponder_hit = true;
 		Threads.main_thread->wait_for(Signals.stop);
 	}
+	Signals.stop = true; // the helpers stop once the main thread does
+	Threads.wait_for_helpers();
+	if(searched){
+		// Take the result of the thread that got the deepest (or the best score at the same depth). //
+		// Note: With several PV lines, only the main thread's lines are consistent with each other.
+		SearchThread* best = Threads.main_thread;
+		for(size_t i = 0; (MultiPV == 1) && (i < Threads.helpers.size()); i++){
+			SearchThread* th = Threads.helpers[i];
+			if((th->completed_depth > best->completed_depth) || 
+			   (th->completed_depth && (th->completed_depth == best->completed_depth) && (th->root_moves[0].score > best->root_moves[0].score))){
+				best = th;
+			}
+		}
+		if(best != Threads.main_thread){
+			Tablebases::extend_pv(best->root_pos, best->root_moves[0].pv);
+			std::cout << uci_pv(best->root_pos, best->completed_depth, -VAL_INF, VAL_INF) << std::endl;
+			LastBest = best->root_moves[0];
+		}
+		RootMoves = best->root_moves;
+	}
 	std::cout << "bestmove " << UCI::move(RootMoves[0].pv[0]);
 	if(RootMoves[0].pv.size() > 1 || RootMoves[0].extract_ponder_from_tt(RootPos)){
 		std::cout << " ponder " << UCI::move(RootMoves[0].pv[1]);
 	}
 	std::cout << std::endl;
-	printf("# Of %llu moves, %llu were on the first try and %llu on the second, so move ordering is %.3f%% (or tot. %.3f%%).\n", failed_high_total, failed_high_first, failed_high_second, double(failed_high_first) / double(failed_high_total) * 100.0, double(failed_high_first + failed_high_second) / double(failed_high_total) * 100.0);
+	uint64_t cutoffs, cutoffs_first, cutoffs_second;
+	Threads.cutoff_stats(cutoffs, cutoffs_first, cutoffs_second);
+	printf("# Of %" PRIu64 " moves, %" PRIu64 " were on the first try and %" PRIu64 " on the second, so move ordering is %.3f%% (or tot. %.3f%%).\n", cutoffs, cutoffs_first, cutoffs_second, double(cutoffs_first) / double(std::max(cutoffs, uint64_t(1))) * 100.0, double(cutoffs_first + cutoffs_second) / double(std::max(cutoffs, uint64_t(1))) * 100.0);
+	uint64_t cache_hits, cache_probes;
+	Threads.eval_cache_stats(cache_hits, cache_probes);
+	printf("# Eval cache: %" PRIu64 " hits of %" PRIu64 " probes (%.1f%%).\n", cache_hits, cache_probes, double(cache_hits) / double(std::max(cache_probes, uint64_t(1))) * 100.0);
+	uint64_t lazy_exits, lazy_tries;
+	Threads.lazy_eval_stats(lazy_exits, lazy_tries);
+	printf("# Lazy eval: %" PRIu64 " early exits of %" PRIu64 " qsearch evaluations (%.1f%%).\n", lazy_exits, lazy_tries, double(lazy_exits) / double(std::max(lazy_tries, uint64_t(1))) * 100.0);
 }
 
 void Search::check_time_limit(void){
@@ -607,8 +927,8 @@ void Search::check_time_limit(void){
 		}
 	} else if(Limits.movetime && (elapsed >= Limits.movetime)){ // if specific amount of time for moving, and we have exhausted that
 		Signals.stop = true; // then we are done
-	} else if(Limits.nodes){
-		assert(false && ("Have not implemented node counters yet!"));
+	} else if(Limits.nodes && (Threads.nodes_searched() >= uint64_t(Limits.nodes))){
+		Signals.stop = true; // backup for the check in the search itself
 	}
 }
 
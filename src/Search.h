@@ -9,6 +9,8 @@
 #include <stack>
 #include <ctime>
 
+template<typename T> struct Stats;
+
 namespace Search {
 	struct Stack {
 		Move* pv; // the principal variation
@@ -16,7 +18,8 @@ namespace Search {
 		Move current_move; // move just played
 		Depth reduction; // reduction, if/a
 		Value static_eval;
-		// TODO: Killers, TT move, etc.
+		Move killers[2]; // quiet moves that caused a cutoff at this ply
+		Stats<Value>* cont_history; // continuation history for the move made at this ply (NULL for a null move)
 		bool skip_early_pruning; // whether we should skip early pruning or not (for stuff like ProbCut, etc.)
 	};
 	
@@ -37,15 +40,8 @@ namespace Search {
 			return pv[0] == m.pv[0]; // since the first move in the PV is the actual root move
 		}
 		
-		void insert_pv_in_tt(Board& pos){ // for re-inserting the PV in the TT
-			// TODO
-			return;
-		}
-		
-		Move extract_ponder_from_tt(Board& pos){ // for extracting the ponder move, PV, etc. from the TT
-			// TODO
-			return MOVE_NONE;
-		}
+		void insert_pv_in_tt(Board& pos); // for re-inserting the PV in the TT
+		bool extract_ponder_from_tt(Board& pos); // for extracting the ponder move from the TT (returns if it found one)
 	};
 	
 	typedef std::vector<RootMove> RootMoveVector; // that logic
@@ -87,14 +83,16 @@ namespace Search {
 	extern int64_t SearchTime; // the start of the search time, in milliseconds
 	extern BoardStateStack SetupStates;
 	extern RootMove LastBest; // the last stable best line of the search
+	extern size_t MultiPV; // number of lines to search (the first 'MultiPV' RootMoves have exact scores after a search)
 	extern Book EngineBook; // the engine book
 	extern Book_Skill EngineBookSkill; // the engine book skill (controls book selectivity, variance, "forgiveness", etc.)
 	
 	void init(void);
+	void clear(void); // forget everything learned (e.g. for a new game)
 	void think(void);
 	void check_time_limit(void); // for TimerThread
+	Value quiesce(Board& pos, std::vector<Move>& pv); // full-window quiescence search (the board needs a thread for its tables), with its PV
 	
-	template<bool Root> uint64_t perft(Board& pos, Depth depth);
 }
 
 #endif // #ifndef SEARCH_INC
\ No newline at end of file
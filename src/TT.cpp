@@ -0,0 +1,64 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+#include "TT.h"
+#include <cstring>
+
+TranspositionTable TT; // our one and only transposition table
+
+void TranspositionTable::resize(size_t mbSize){
+	// The number of clusters is always a power of 2 so we can index with a mask. //
+	size_t new_count = size_t(1) << msb((mbSize * 1024 * 1024) / sizeof(Cluster));
+	if(new_count == clusterCount){
+		clear(); // same size, but the caller still expects an empty table
+		return;
+	}
+	clusterCount = new_count;
+	free(mem);
+	mem = calloc(clusterCount * sizeof(Cluster) + CacheLineSize - 1, 1); // zeroed out already
+	if(!mem){
+		Error("Failed to allocate " + std::to_string(mbSize) + " MB for the transposition table.");
+	}
+	table = (Cluster*)((uintptr_t(mem) + CacheLineSize - 1) & ~uintptr_t(CacheLineSize - 1)); // align to a cache line
+}
+
+void TranspositionTable::clear(void){
+	std::memset(table, 0, clusterCount * sizeof(Cluster));
+}
+
+TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
+	TTEntry* const tte = first_entry(key);
+	const uint16_t key16 = key >> 48; // the upper 16 bits are stored in the entry
+	for(int i = 0; i < ClusterSize; i++){
+		if(!tte[i].key16 || tte[i].key16 == key16){
+			if(tte[i].key16 && ((tte[i].genBound8 & 0xFC) != generation8)){
+				tte[i].genBound8 = uint8_t(generation8 | tte[i].bound()); // refresh it so it doesn't get replaced as stale
+			}
+			found = bool(tte[i].key16);
+			return &tte[i];
+		}
+	}
+	// No match, so find the entry to replace: the one that is shallowest and oldest counts the least. //
+	// Note: The 259 = 256 + 3 makes sure the bound bits do not borrow into the generation difference.
+	TTEntry* replace = tte;
+	for(int i = 1; i < ClusterSize; i++){
+		if((replace->depth8 - ((259 + generation8 - replace->genBound8) & 0xFC) * 2) >
+		   (tte[i].depth8 - ((259 + generation8 - tte[i].genBound8) & 0xFC) * 2)){
+			replace = &tte[i];
+		}
+	}
+	found = false;
+	return replace;
+}
+
+int TranspositionTable::hashfull(void) const {
+	// Sample the first thousand entries for ones written in this search (empty ones don't count). //
+	int cnt = 0;
+	for(int i = 0; i < 1000 / ClusterSize; i++){
+		const TTEntry* tte = &table[i].entry[0];
+		for(int j = 0; j < ClusterSize; j++){
+			if(tte[j].key16 && ((tte[j].genBound8 & 0xFC) == generation8)) ++cnt;
+		}
+	}
+	return cnt;
+}
@@ -0,0 +1,87 @@
+#ifndef TT_INC
+#define TT_INC
+
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+
+/*
+* A transposition table entry is 10 bytes:
+* key: 16 bits (upper 16 bits of the Zobrist key, the lower bits are used for the index)
+* move: 16 bits
+* value: 16 bits
+* static eval: 16 bits
+* generation: 6 bits, bound: 2 bits (packed together)
+* depth: 8 bits
+*/
+
+struct TTEntry {
+	Move move(void) const { return Move(move16); }
+	Value value(void) const { return Value(value16); }
+	Value eval(void) const { return Value(eval16); }
+	Depth depth(void) const { return Depth(depth8); }
+	Bound bound(void) const { return Bound(genBound8 & 0x3); }
+
+	void save(Key k, Value v, Bound b, Depth d, Move m, Value ev, uint8_t g){
+		// Keep the old move if we don't have a new one for the same position. //
+		if(m || (k >> 48) != key16){
+			move16 = uint16_t(m);
+		}
+		// Don't overwrite a deeper entry of the same position unless we have an exact score. //
+		if(((k >> 48) != key16) || (d > depth8 - 4) || (b == BOUND_EXACT)){
+			key16 = uint16_t(k >> 48);
+			value16 = int16_t(v);
+			eval16 = int16_t(ev);
+			genBound8 = uint8_t(g | b);
+			depth8 = int8_t(d);
+		}
+	}
+
+	private:
+		friend class TranspositionTable;
+
+		uint16_t key16;
+		uint16_t move16;
+		int16_t value16;
+		int16_t eval16;
+		uint8_t genBound8;
+		int8_t depth8;
+};
+
+class TranspositionTable {
+	public:
+		static const int CacheLineSize = 64;
+		static const int ClusterSize = 3; // number of entries per cluster
+		static const int DefaultSize = 16; // in megabytes
+
+	private:
+		struct Cluster {
+			TTEntry entry[ClusterSize];
+			char padding[2]; // pad to 32 bytes so two clusters fit exactly in one cache line
+		};
+
+		size_t clusterCount; // always a power of 2
+		Cluster* table; // aligned to a cache line
+		void* mem; // what was actually allocated (so we can free it)
+		uint8_t generation8; // the lower 2 bits are used by Bound
+
+	public:
+		TranspositionTable(void) : clusterCount(0), table(NULL), mem(NULL), generation8(0) { }
+		~TranspositionTable(void){ free(mem); }
+
+		void new_search(void){ generation8 += 4; } // lower 2 bits are used by Bound
+		uint8_t generation(void) const { return generation8; }
+		TTEntry* probe(const Key key, bool& found) const; // find the entry for the key (or the one to replace)
+		int hashfull(void) const; // approximate permill of the table used in this search
+		void resize(size_t mbSize); // resize to the given size in megabytes (clears it as well)
+		void clear(void); // clear all entries
+
+		TTEntry* first_entry(const Key key) const {
+			// The lower bits of the key index the cluster. //
+			return &table[size_t(key) & (clusterCount - 1)].entry[0];
+		}
+};
+
+extern TranspositionTable TT;
+
+#endif // #ifndef TT_INC
@@ -0,0 +1,794 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+#include "MoveGen.h"
+#include "Endgame.h"
+#include "Threads.h"
+#include "Tablebase.h"
+#include <fstream>
+#include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Tablebases {
+	int Cardinality = 0;
+}
+
+namespace {
+	const char Magic[8] = { 'C', 'T', 'B', 'L', 'B', 'A', 'S', '2' };
+	const size_t HeaderSize = 32; // magic, piece count (4 bytes), code (zero padded)
+	const int MaxMen = Tablebases::MaxMen;
+
+	const uint8_t TB_DRAW = 0, TB_INVALID = 255;
+	const int MaxDistance = 252; // the longest distance (in plies) we can encode for both wins and losses
+
+	inline uint8_t encode_win(int plies){ return uint8_t((plies + 1) / 2); } // wins are always an odd number of plies
+	inline uint8_t encode_loss(int plies){ return uint8_t(128 + plies / 2); } // losses are always an even number of plies
+	inline bool is_win(uint8_t v){ return v && (v < 128); }
+	inline bool is_loss(uint8_t v){ return (v >= 128) && (v != TB_INVALID); }
+	inline int distance_of(uint8_t v){ return (v < 128) ? (2 * v - 1) : (2 * (v - 128)); }
+
+	// On disk, the result (2 bits per position) is kept apart from the distance (1 byte per position, in moves), //
+	// so most probes (draws) only touch the small part of the file.
+	enum { WDL_DRAW, WDL_WIN, WDL_LOSS, WDL_INVALID };
+	inline size_t wdl_bytes(size_t size){ return (size + 3) / 4; }
+
+	struct TBTable {
+		std::string code; // e.g. "KRKP" (the first group is white)
+		int men; // number of pieces, kings included
+		int pawns; // number of pawns
+		Side side[MaxMen]; // piece slots: white king, black king, then the white pieces, then the black pieces
+		PieceType type[MaxMen];
+		int groups; // groups of like pieces (same side and type), which are indexed together
+		int group_first[MaxMen], group_len[MaxMen]; // first slot and number of pieces by group
+		size_t group_size[MaxMen]; // number of ways to place each group
+		size_t size; // number of positions
+		const uint8_t* wdl; // results, 4 positions per byte (NULL if the table is not mapped)
+		const uint8_t* dtm; // distances
+		void* map;
+		size_t map_len;
+	};
+
+	struct TBKeyEntry {
+		Key key; // material key (0 = empty slot)
+		TBTable* table;
+		bool flipped; // if the colors have to be swapped to look the position up
+	};
+
+	std::vector<TBTable*> Tables; // every signature with up to MaxMen pieces, in generation order
+	std::map<std::string, TBTable*> TablesByCode;
+	const int KeySlots = 1024; // plenty for both orientations of every table
+	TBKeyEntry KeyTable[KeySlots];
+
+	size_t Binomial[SQUARE_NB + 1][MaxMen]; // by [n][k] = n choose k
+	int KKIndex[2][SQUARE_NB][SQUARE_NB]; // by [pawns][white king][black king] (-1 if the pair is not indexed)
+	Square KKSquares[2][int(SQUARE_NB) * int(SQUARE_NB)][SIDE_NB]; // by [pawns][king pair index]
+	size_t KKCount[2]; // by [pawns]
+
+	inline Square flip_diagonal(Square s){ return make_square(Rank(file_of(s)), File(rank_of(s))); }
+
+	void init_index(void){
+		for(int n = 0; n <= SQUARE_NB; n++){
+			Binomial[n][0] = 1;
+			for(int k = 1; k < MaxMen; k++){
+				Binomial[n][k] = n ? (Binomial[n - 1][k - 1] + Binomial[n - 1][k]) : 0;
+			}
+		}
+		// Without pawns, the white king is always in the a1-d1-d4 triangle (and on the diagonal, the black king is on or below it). //
+		// With pawns, only the files can be mirrored, so the white king is on files A-D.
+		for(int p = 0; p < 2; p++){
+			KKCount[p] = 0;
+			for(Square wk = SQ_A1; wk <= SQ_H8; wk++){
+				for(Square bk = SQ_A1; bk <= SQ_H8; bk++){
+					KKIndex[p][wk][bk] = -1;
+					if((file_of(wk) > FILE_D) || (distance(wk, bk) <= 1)) continue;
+					if(!p && ((int(rank_of(wk)) > int(file_of(wk))) ||
+					   ((rank_of(wk) == Rank(file_of(wk))) && (int(rank_of(bk)) > int(file_of(bk)))))) continue;
+					KKSquares[p][KKCount[p]][WHITE] = wk;
+					KKSquares[p][KKCount[p]][BLACK] = bk;
+					KKIndex[p][wk][bk] = int(KKCount[p]++);
+				}
+			}
+		}
+	}
+
+	inline size_t group_index(const TBTable* t, int g, const Square* sq){
+		// The squares of like pieces are a combination, so they are indexed as one (in sorted order). //
+		const int first = t->group_first[g], len = t->group_len[g], base = (t->type[first] == PAWN) ? 8 : 0; // pawns are never on ranks 1 or 8
+		int s[MaxMen];
+		for(int k = 0; k < len; k++){
+			int v = int(sq[first + k]) - base, j = k;
+			for(; (j > 0) && (s[j - 1] > v); j--) s[j] = s[j - 1];
+			s[j] = v;
+		}
+		size_t idx = 0;
+		for(int k = 0; k < len; k++){
+			idx += Binomial[s[k]][k + 1];
+		}
+		return idx;
+	}
+
+	inline size_t tb_index(const TBTable* t, const Square* psq, Side stm){
+		// Mirror the white king into the indexed area (everything else follows it), then index the king pair //
+		// and each group of like pieces.
+		Square sq[MaxMen];
+		const int flip = ((file_of(psq[0]) >= FILE_E) ? 7 : 0) ^ ((!t->pawns && (rank_of(psq[0]) >= RANK_5)) ? 56 : 0);
+		sq[0] = Square(psq[0] ^ flip);
+		sq[1] = Square(psq[1] ^ flip);
+		for(int i = 2; i < t->men; i++){
+			sq[i] = Square(psq[i] ^ flip);
+		}
+		if(!t->pawns){
+			const int d0 = int(rank_of(sq[0])) - int(file_of(sq[0])), d1 = int(rank_of(sq[1])) - int(file_of(sq[1]));
+			if((d0 > 0) || (!d0 && (d1 > 0))){
+				for(int i = 0; i < t->men; i++) sq[i] = flip_diagonal(sq[i]);
+			}
+		}
+		const int kk = KKIndex[t->pawns != 0][sq[0]][sq[1]];
+		assert(kk >= 0);
+		size_t idx = size_t(kk);
+		for(int g = 0; g < t->groups; g++){
+			idx = idx * t->group_size[g] + group_index(t, g, sq);
+		}
+		return (idx << 1) | size_t(stm);
+	}
+
+	inline Side tb_decode(const TBTable* t, size_t idx, Square* sq){
+		const Side stm = Side(idx & 1);
+		idx >>= 1;
+		for(int g = t->groups - 1; g >= 0; g--){
+			size_t gi = idx % t->group_size[g];
+			idx /= t->group_size[g];
+			const int first = t->group_first[g], base = (t->type[first] == PAWN) ? 8 : 0;
+			int s = (base ? 48 : SQUARE_NB) - 1;
+			for(int k = t->group_len[g] - 1; k >= 0; k--, s--){
+				while(Binomial[s][k + 1] > gi) --s;
+				gi -= Binomial[s][k + 1];
+				sq[first + k] = Square(s + base);
+			}
+		}
+		sq[0] = KKSquares[t->pawns != 0][idx][WHITE];
+		sq[1] = KKSquares[t->pawns != 0][idx][BLACK];
+		return stm;
+	}
+
+	inline int wdl_of(const TBTable* t, size_t idx){
+		return (t->wdl[idx >> 2] >> (2 * (idx & 3))) & 3;
+	}
+
+	inline uint8_t stored_value(const TBTable* t, size_t idx){
+		// A mapped position, in the generator's encoding. //
+		switch(wdl_of(t, idx)){
+			case WDL_WIN: return t->dtm[idx];
+			case WDL_LOSS: return uint8_t(128 + t->dtm[idx]);
+			case WDL_INVALID: return TB_INVALID;
+			default: return TB_DRAW;
+		}
+	}
+
+	int side_value(const std::string& pcs){
+		int v = 0;
+		for(char c : pcs) v += PieceValue[MG][PieceChar.find(c)];
+		return v;
+	}
+
+	bool is_canonical(const std::string& w, const std::string& b){
+		// The stronger side is always white in a table (ties are broken by the piece letters). //
+		const int vw = side_value(w), vb = side_value(b);
+		return (vw > vb) || ((vw == vb) && (w >= b));
+	}
+
+	std::string sort_pieces(std::string pcs){
+		// Queens first, pawns last. //
+		std::sort(pcs.begin(), pcs.end(), [](char a, char b){ return PieceChar.find(a) > PieceChar.find(b); });
+		return pcs;
+	}
+
+	std::string code_for(const std::string& w, const std::string& b, bool& flipped){
+		// Get the table code for white pieces 'w' vs. black pieces 'b' (excl. kings). //
+		flipped = !is_canonical(w, b);
+		return flipped ? ("K" + b + "K" + w) : ("K" + w + "K" + b);
+	}
+
+	TBTable* new_table(const std::string& w, const std::string& b){
+		TBTable* t = new TBTable();
+		t->code = "K" + w + "K" + b;
+		t->men = 2 + int(w.length() + b.length());
+		t->side[0] = WHITE;
+		t->type[0] = KING;
+		t->side[1] = BLACK;
+		t->type[1] = KING;
+		int n = 2;
+		for(char c : w){ t->side[n] = WHITE; t->type[n++] = PieceType(PieceChar.find(c)); }
+		for(char c : b){ t->side[n] = BLACK; t->type[n++] = PieceType(PieceChar.find(c)); }
+		t->pawns = int(std::count(t->code.begin(), t->code.end(), 'P'));
+		t->groups = 0;
+		t->size = KKCount[t->pawns != 0] * 2;
+		for(int i = 2; i < t->men; i++){
+			if((i > 2) && (t->side[i] == t->side[i - 1]) && (t->type[i] == t->type[i - 1])){
+				++t->group_len[t->groups - 1];
+				continue;
+			}
+			t->group_first[t->groups] = i;
+			t->group_len[t->groups++] = 1;
+		}
+		for(int g = 0; g < t->groups; g++){
+			t->group_size[g] = Binomial[(t->type[t->group_first[g]] == PAWN) ? 48 : SQUARE_NB][t->group_len[g]];
+			t->size *= t->group_size[g];
+		}
+		t->wdl = t->dtm = NULL;
+		t->map = NULL;
+		t->map_len = 0;
+		return t;
+	}
+
+	void add_side_sets(int n, int first, const std::string& cur, std::vector<std::string>& out){
+		// All multisets of n pieces out of QRBNP (in that order). //
+		if(!n){
+			out.push_back(cur);
+			return;
+		}
+		for(int pt = first; pt >= PAWN; pt--){
+			add_side_sets(n - 1, pt, cur + PieceChar[pt], out);
+		}
+	}
+
+	void build_tables(void){
+		if(!Tables.empty()) return;
+		init_index();
+		for(int men = 3; men <= MaxMen; men++){
+			std::vector<TBTable*> this_count;
+			for(int nw = men - 2; nw >= 0; nw--){
+				std::vector<std::string> ws, bs;
+				add_side_sets(nw, QUEEN, "", ws);
+				add_side_sets(men - 2 - nw, QUEEN, "", bs);
+				for(const std::string& w : ws){
+					for(const std::string& b : bs){
+						if(!is_canonical(w, b)) continue;
+						if((w.find('P') != std::string::npos) && (b.find('P') != std::string::npos)) continue; // e.p. would matter, not supported
+						this_count.push_back(new_table(w, b));
+					}
+				}
+			}
+			// Promotions turn pawns into pieces, so tables with fewer pawns have to come first. //
+			std::stable_sort(this_count.begin(), this_count.end(), [](const TBTable* a, const TBTable* b){ return a->pawns < b->pawns; });
+			for(TBTable* t : this_count){
+				Tables.push_back(t);
+				TablesByCode[t->code] = t;
+			}
+		}
+	}
+
+	void add_key(Key key, TBTable* t, bool flipped){
+		int i = int(key & (KeySlots - 1));
+		while(KeyTable[i].key && (KeyTable[i].key != key)){
+			i = (i + 1) & (KeySlots - 1);
+		}
+		KeyTable[i].key = key;
+		KeyTable[i].table = t;
+		KeyTable[i].flipped = flipped;
+	}
+
+	const TBKeyEntry* find_key(Key key){
+		for(int i = int(key & (KeySlots - 1)); KeyTable[i].key; i = (i + 1) & (KeySlots - 1)){
+			if(KeyTable[i].key == key) return &KeyTable[i];
+		}
+		return NULL;
+	}
+
+	void unmap_table(TBTable* t){
+		if(t->map) munmap(t->map, t->map_len);
+		t->wdl = t->dtm = NULL;
+		t->map = NULL;
+		t->map_len = 0;
+	}
+
+	bool map_table(TBTable* t, const std::string& path){
+		const std::string fname = path + "/" + t->code + ".ctb";
+		const int fd = open(fname.c_str(), O_RDONLY);
+		if(fd < 0) return false;
+		struct stat sb;
+		if((fstat(fd, &sb) < 0) || (size_t(sb.st_size) != HeaderSize + wdl_bytes(t->size) + t->size)){
+			close(fd);
+			return false;
+		}
+		void* m = mmap(NULL, size_t(sb.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(m == MAP_FAILED) return false;
+		const char* hdr = (const char*)m;
+		uint32_t men;
+		std::memcpy(&men, hdr + 8, sizeof(men));
+		if(std::memcmp(hdr, Magic, sizeof(Magic)) || (int(men) != t->men) || (t->code != std::string(hdr + 12))){
+			munmap(m, size_t(sb.st_size));
+			return false;
+		}
+		t->map = m;
+		t->map_len = size_t(sb.st_size);
+		t->wdl = (const uint8_t*)m + HeaderSize;
+		t->dtm = t->wdl + wdl_bytes(t->size);
+		return true;
+	}
+
+	void register_table(TBTable* t){
+		add_key(key_for_code(t->code, WHITE), t, false);
+		const Key flipped_key = key_for_code(t->code, BLACK);
+		if(!find_key(flipped_key)) add_key(flipped_key, t, true); // symmetric tables (e.g. KRKR) only need one
+	}
+
+	// Generation //
+
+	struct Conversion {
+		// A capture and/or promotion leads to another table, with the pieces in different slots. //
+		const TBTable* child; // NULL if only the kings are left
+		bool flipped;
+		int slot[MaxMen]; // slot in the parent for each slot of the child
+	};
+
+	Conversion make_conversion(const TBTable* t, int removed, int promoted, PieceType promo){
+		Conversion c;
+		c.child = NULL;
+		c.flipped = false;
+		std::string pcs[SIDE_NB];
+		for(int i = 2; i < t->men; i++){
+			if(i == removed) continue;
+			pcs[t->side[i]] += PieceChar[(i == promoted) ? promo : t->type[i]];
+		}
+		if(pcs[WHITE].empty() && pcs[BLACK].empty()) return c;
+		const std::string code = code_for(sort_pieces(pcs[WHITE]), sort_pieces(pcs[BLACK]), c.flipped);
+		c.child = TablesByCode[code];
+		assert(c.child);
+		bool used[MaxMen] = { };
+		for(int k = 0; k < c.child->men; k++){
+			const Side s = c.flipped ? ~c.child->side[k] : c.child->side[k];
+			for(int i = 0; i < t->men; i++){
+				const PieceType pt = (i == promoted) ? promo : t->type[i];
+				if(!used[i] && (i != removed) && (t->side[i] == s) && (pt == c.child->type[k])){
+					used[i] = true;
+					c.slot[k] = i;
+					break;
+				}
+			}
+		}
+		return c;
+	}
+
+	inline uint8_t child_value(const Conversion& c, const Square* sq, Side stm){
+		if(!c.child) return TB_DRAW; // bare kings
+		Square csq[MaxMen];
+		for(int k = 0; k < c.child->men; k++){
+			csq[k] = c.flipped ? ~sq[c.slot[k]] : sq[c.slot[k]];
+		}
+		return stored_value(c.child, tb_index(c.child, csq, c.flipped ? ~stm : stm));
+	}
+
+	struct GenWork {
+		// Shared by all of the generator threads for one table. //
+		const TBTable* table;
+		uint8_t* values;
+		uint8_t* todo[2]; // positions to look at in this pass and the next (by pass parity)
+		int pass;
+		Conversion capture[MaxMen]; // by captured slot
+		Conversion promote[MaxMen][PIECE_TYPE_NB][MaxMen + 1]; // by [pawn slot][promotion type][captured slot + 1]
+		int d; // the distance (in plies) being resolved in this pass
+		size_t next; // next chunk of positions
+		size_t changed; // positions resolved in this pass
+		int pending; // the smallest distance above 'd' that is waiting to be resolved
+		Mutex mutex;
+	};
+
+	const size_t ChunkSize = 1 << 16;
+
+	inline bool attacked(const TBTable* t, Square s, Side by, const Square* sq, int skip, Bitboard occ){
+		for(int i = 0; i < t->men; i++){
+			if((i != skip) && (t->side[i] == by) && (attacks_bb(make_piece(by, t->type[i]), sq[i], occ) & s)){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void mark_parents(GenWork& w, const Square* sq, Side stm, Bitboard occ){
+		// A position was resolved, so everything that can reach it (in this table) needs another look in the next pass. //
+		const TBTable* t = w.table;
+		uint8_t* next = w.todo[(w.pass + 1) & 1];
+		const Side them = ~stm;
+		Square psq[MaxMen];
+		for(int i = 0; i < t->men; i++) psq[i] = sq[i];
+		for(int i = 0; i < t->men; i++){
+			if(t->side[i] != them) continue;
+			const Square to = sq[i];
+			Bitboard froms;
+			if(t->type[i] == PAWN){
+				const Square down = pawn_push(stm);
+				froms = 0;
+				if((relative_rank(them, to) >= RANK_3) && !(occ & (to + down))){
+					froms |= to + down;
+					if((relative_rank(them, to) == RANK_4) && !(occ & (to + down + down))) froms |= to + down + down;
+				}
+			} else {
+				froms = attacks_bb(make_piece(them, t->type[i]), to, occ) & ~occ;
+				if(t->type[i] == KING) froms &= ~StepAttacksBB[make_piece(stm, KING)][sq[1 - i]]; // not next to the other king
+			}
+			while(froms){
+				psq[i] = pop_lsb(&froms);
+				next[tb_index(t, psq, them)] = 1;
+				if(!t->pawns){
+					// With both kings on the diagonal, a position and its mirror image have different indices //
+					// (and the parent might only reach one of them), so look at both.
+					Square msq[MaxMen];
+					for(int k = 0; k < t->men; k++) msq[k] = flip_diagonal(psq[k]);
+					next[tb_index(t, msq, them)] = 1;
+				}
+			}
+			psq[i] = to;
+		}
+	}
+
+	void gen_position(GenWork& w, size_t idx, size_t& changed, int& pending){
+		const TBTable* t = w.table;
+		const int men = t->men;
+		Square sq[MaxMen];
+		const Side stm = tb_decode(t, idx, sq);
+		Bitboard occ = 0, own = 0;
+		for(int i = 0; i < men; i++){
+			if(occ & sq[i]){
+				w.values[idx] = TB_INVALID;
+				return;
+			}
+			occ |= sq[i];
+			if(t->side[i] == stm) own |= sq[i];
+		}
+		const int our_king = (stm == WHITE) ? 0 : 1;
+		if((distance(sq[0], sq[1]) <= 1) || attacked(t, sq[1 - our_king], stm, sq, -1, occ)){
+			w.values[idx] = TB_INVALID; // the side not to move can't be in check
+			return;
+		}
+		const bool in_check = attacked(t, sq[our_king], ~stm, sq, -1, occ);
+		bool has_move = false, all_win = true;
+		int best_win = MaxDistance + 1, worst_loss = 0;
+		Square nsq[MaxMen];
+		for(int i = 0; i < men; i++){
+			if(t->side[i] != stm) continue;
+			const Square from = sq[i];
+			const PieceType pt = t->type[i];
+			Bitboard targets;
+			if(pt == PAWN){
+				const Square up = pawn_push(stm);
+				targets = StepAttacksBB[make_piece(stm, PAWN)][from] & occ & ~own;
+				if(!(occ & (from + up))){
+					targets |= from + up;
+					if((relative_rank(stm, from) == RANK_2) && !(occ & (from + up + up))) targets |= from + up + up;
+				}
+			} else {
+				targets = attacks_bb(make_piece(stm, pt), from, occ) & ~own;
+			}
+			while(targets){
+				const Square to = pop_lsb(&targets);
+				int capd = -1;
+				if(occ & to){
+					for(int j = 2; j < men; j++){
+						if((t->side[j] != stm) && (sq[j] == to)) capd = j;
+					}
+					assert(capd >= 0); // kings can't be captured in a legal position
+				}
+				for(int j = 0; j < men; j++) nsq[j] = sq[j];
+				nsq[i] = to;
+				if(attacked(t, nsq[our_king], ~stm, nsq, capd, (occ ^ from) | to)){
+					continue; // illegal
+				}
+				has_move = true;
+				// Get the value of every possible child position (from the opponent's point of view). //
+				uint8_t cvs[4];
+				int cnt = 0;
+				if((pt == PAWN) && (relative_rank(stm, to) == RANK_8)){
+					for(PieceType promo = QUEEN; promo >= KNIGHT; promo--){
+						cvs[cnt++] = child_value(w.promote[i][promo][capd + 1], nsq, ~stm);
+					}
+				} else if(capd >= 0){
+					cvs[cnt++] = child_value(w.capture[capd], nsq, ~stm);
+				} else {
+					cvs[cnt++] = w.values[tb_index(t, nsq, ~stm)];
+				}
+				for(int k = 0; k < cnt; k++){
+					const uint8_t cv = cvs[k];
+					assert(cv != TB_INVALID);
+					if(is_loss(cv)){
+						best_win = std::min(best_win, distance_of(cv) + 1);
+						all_win = false;
+						if(best_win == w.d){ // can't do better than this
+							w.values[idx] = encode_win(w.d);
+							++changed;
+							mark_parents(w, sq, stm, occ);
+							return;
+						}
+					} else if(is_win(cv)){
+						worst_loss = std::max(worst_loss, distance_of(cv) + 1);
+					} else {
+						all_win = false; // a draw, or not known yet
+					}
+				}
+			}
+		}
+		int result = -1;
+		bool win = false;
+		if(!has_move){
+			if(!in_check) return; // stalemate
+			result = 0;
+		} else if(best_win <= MaxDistance){
+			result = best_win;
+			win = true;
+		} else if(all_win){
+			result = worst_loss;
+		}
+		if((result < 0) || (result > MaxDistance)) return;
+		if(result == w.d){
+			w.values[idx] = win ? encode_win(result) : encode_loss(result);
+			++changed;
+			mark_parents(w, sq, stm, occ);
+		} else if(result > w.d){
+			pending = std::min(pending, result); // everything this depends on is known, it just isn't that far yet
+			w.todo[(w.pass + 1) & 1][idx] = 1;
+		}
+	}
+
+	void* gen_thread_func(void* arg){
+		GenWork* w = (GenWork*)arg;
+		size_t changed = 0;
+		int pending = MaxDistance + 1;
+		const size_t size = w->table->size;
+		const uint8_t* todo = w->todo[w->pass & 1];
+		while(true){
+			w->mutex.lock();
+			const size_t start = w->next;
+			w->next += ChunkSize;
+			w->mutex.unlock();
+			if(start >= size) break;
+			for(size_t idx = start, end = std::min(start + ChunkSize, size); idx < end; idx++){
+				if(!w->values[idx] && todo[idx]) gen_position(*w, idx, changed, pending);
+			}
+		}
+		w->mutex.lock();
+		w->changed += changed;
+		w->pending = std::min(w->pending, pending);
+		w->mutex.unlock();
+		return NULL;
+	}
+
+	bool generate_table(TBTable* t, const TB_Options& op){
+		const int64_t start = get_system_time_msec();
+		GenWork* w = new GenWork();
+		w->table = t;
+		w->values = (uint8_t*)calloc(t->size, 1);
+		w->todo[0] = (uint8_t*)malloc(t->size);
+		w->todo[1] = (uint8_t*)calloc(t->size, 1);
+		if(!w->values || !w->todo[0] || !w->todo[1]){
+			Error("Failed to allocate " + std::to_string(3 * t->size >> 20) + " MB for generating " + t->code + ".");
+		}
+		std::memset(w->todo[0], 1, t->size); // the first pass looks at everything
+		for(int j = 2; j < t->men; j++){
+			w->capture[j] = make_conversion(t, j, -1, NO_PIECE_TYPE);
+		}
+		for(int i = 2; i < t->men; i++){
+			if(t->type[i] != PAWN) continue;
+			for(PieceType promo = KNIGHT; promo <= QUEEN; promo++){
+				w->promote[i][promo][0] = make_conversion(t, -1, i, promo);
+				for(int j = 2; j < t->men; j++){
+					if(t->side[j] != t->side[i]) w->promote[i][promo][j + 1] = make_conversion(t, j, i, promo);
+				}
+			}
+		}
+		// Resolve everything one distance at a time: a position at distance d only depends on ones at d - 1 and below. //
+		// After the first pass, only positions with a newly resolved child (or a known result further away) are looked at again.
+		int passes = 0;
+		w->d = w->pass = 0;
+		while(w->d <= MaxDistance){
+			w->next = w->changed = 0;
+			w->pending = MaxDistance + 1;
+			run_jobs(op.threads, gen_thread_func, w);
+			std::memset(w->todo[w->pass & 1], 0, t->size);
+			++w->pass;
+			++passes;
+			if(w->changed) ++w->d;
+			else if(w->pending <= MaxDistance) w->d = w->pending; // nothing at this distance, skip ahead
+			else break;
+		}
+		free(w->todo[0]);
+		free(w->todo[1]);
+		// Write it out (everything not resolved by now is a draw), results first and then the distances in moves. //
+		size_t wins = 0, losses = 0, draws = 0;
+		int longest = 0;
+		std::vector<uint8_t> wdl(wdl_bytes(t->size), 0);
+		for(size_t idx = 0; idx < t->size; idx++){
+			uint8_t& v = w->values[idx];
+			int r = WDL_DRAW;
+			if(v && (v != TB_INVALID)) longest = std::max(longest, distance_of(v));
+			if(v == TB_INVALID){
+				r = WDL_INVALID;
+				v = 0;
+			} else if(is_win(v)){
+				r = WDL_WIN;
+				++wins;
+			} else if(is_loss(v)){
+				r = WDL_LOSS;
+				++losses;
+				v -= 128;
+			} else {
+				++draws;
+			}
+			wdl[idx >> 2] |= uint8_t(r << (2 * (idx & 3)));
+		}
+		const std::string fname = op.path + "/" + t->code + ".ctb";
+		std::ofstream ofp(fname, std::ios::binary);
+		if(!ofp.is_open()){
+			Error("Could not open tablebase file '" + fname + "' for writing.");
+		}
+		char hdr[HeaderSize] = { };
+		std::memcpy(hdr, Magic, sizeof(Magic));
+		const uint32_t men = uint32_t(t->men);
+		std::memcpy(hdr + 8, &men, sizeof(men));
+		std::strncpy(hdr + 12, t->code.c_str(), HeaderSize - 13);
+		ofp.write(hdr, HeaderSize);
+		ofp.write((const char*)wdl.data(), wdl.size());
+		ofp.write((const char*)w->values, t->size);
+		ofp.close();
+		free(w->values);
+		delete w;
+		printf("%-6s %6.1f MB  wins %10zu  draws %10zu  losses %10zu  longest %3d plies  %3d passes  %" PRId64 " ms\n",
+			t->code.c_str(), double(wdl.size() + t->size) / (1 << 20), wins, draws, losses, longest, passes, get_system_time_msec() - start);
+		return bool(ofp);
+	}
+
+	void add_with_children(TBTable* t, std::vector<bool>& want){
+		// Mark a table and everything its captures/promotions lead to. //
+		const size_t i = std::find(Tables.begin(), Tables.end(), t) - Tables.begin();
+		if(want[i]) return;
+		want[i] = true;
+		for(int j = 2; j < t->men; j++){
+			const Conversion c = make_conversion(t, j, -1, NO_PIECE_TYPE);
+			if(c.child) add_with_children((TBTable*)c.child, want);
+			if(t->type[j] != PAWN) continue;
+			for(PieceType promo = KNIGHT; promo <= QUEEN; promo++){
+				const Conversion p = make_conversion(t, -1, j, promo);
+				if(p.child) add_with_children((TBTable*)p.child, want);
+			}
+		}
+	}
+}
+
+void Tablebases::init(const std::string& path, int probe_limit){
+	build_tables();
+	std::memset(KeyTable, 0, sizeof(KeyTable));
+	Cardinality = 0;
+	int count = 0;
+	for(TBTable* t : Tables){
+		unmap_table(t);
+		if(path.empty() || (t->men > probe_limit) || !map_table(t, path)) continue;
+		register_table(t);
+		Cardinality = std::max(Cardinality, t->men);
+		++count;
+	}
+	if(count) std::cout << "info string Found " << count << " tablebases (up to " << Cardinality << " pieces)" << std::endl;
+}
+
+bool Tablebases::probe(const Board& pos, int& wdl, int& plies){
+	if(pos.can_castle()) return false;
+	if(pos.all() == pos.pieces(KING)){ // bare kings
+		wdl = plies = 0;
+		return true;
+	}
+	const TBKeyEntry* e = find_key(pos.material_key());
+	if(!e) return false;
+	const TBTable* t = e->table;
+	Bitboard left[SIDE_NB][PIECE_TYPE_NB];
+	for(Side c = WHITE; c <= BLACK; c++){
+		for(PieceType pt = PAWN; pt <= KING; pt++){
+			left[c][pt] = pos.pieces(c, pt);
+		}
+	}
+	Square sq[MaxMen];
+	for(int i = 0; i < t->men; i++){
+		const Side c = e->flipped ? ~t->side[i] : t->side[i];
+		assert(left[c][t->type[i]]);
+		sq[i] = pop_lsb(&left[c][t->type[i]]);
+		if(e->flipped) sq[i] = ~sq[i];
+	}
+	const uint8_t v = stored_value(t, tb_index(t, sq, e->flipped ? ~pos.side_to_move() : pos.side_to_move()));
+	if(v == TB_INVALID) return false;
+	wdl = is_win(v) ? 1 : (is_loss(v) ? -1 : 0);
+	plies = v ? distance_of(v) : 0;
+	return true;
+}
+
+namespace {
+	bool rank_moves(const Board& pos, const std::vector<Move>& moves, std::vector<int>& rank){
+		// Returns false if any of the tables the moves lead to are missing. //
+		Board p;
+		p = pos;
+		rank.resize(moves.size());
+		for(size_t i = 0; i < moves.size(); i++){
+			int wdl, plies;
+			BoardState st;
+			p.do_move(moves[i], st);
+			const bool found = Tablebases::probe(p, wdl, plies);
+			p.undo_move(moves[i]);
+			if(!found) return false;
+			// Win as fast as possible, or lose as slowly as possible. //
+			rank[i] = (wdl < 0) ? (1000 - plies) : ((wdl > 0) ? (-1000 + plies) : 0);
+		}
+		return true;
+	}
+}
+
+void Tablebases::filter_root_moves(const Board& pos, std::vector<Move>& moves){
+	int wdl, plies;
+	std::vector<int> rank;
+	if(moves.empty() || !probe(pos, wdl, plies)) return;
+	if(!rank_moves(pos, moves, rank)) return; // the table we would need isn't there, so leave it to the search
+	const int best = *std::max_element(rank.begin(), rank.end());
+	std::vector<Move> kept;
+	for(size_t i = 0; i < moves.size(); i++){
+		if(rank[i] == best) kept.push_back(moves[i]);
+	}
+	moves.swap(kept);
+}
+
+Move Tablebases::best_move(const Board& pos){
+	std::vector<Move> moves;
+	std::vector<int> rank;
+	for(MoveList<LEGAL> it(pos); *it; it++){
+		moves.push_back(*it);
+	}
+	if(moves.empty() || !rank_moves(pos, moves, rank)) return MOVE_NONE;
+	return moves[std::max_element(rank.begin(), rank.end()) - rank.begin()];
+}
+
+void Tablebases::extend_pv(const Board& pos, std::vector<Move>& pv){
+	// Follow the best moves to mate (a drawn line only gets enough for a ponder move, since any drawing move will do). //
+	if(!Cardinality || pv.empty() || (pv[0] == MOVE_NONE) || (pv.size() >= size_t(MAX_PLY))) return;
+	Board p;
+	p = pos;
+	std::vector<BoardState> states(MAX_PLY); // not on the stack, every state carries an accumulator
+	for(size_t i = 0; i < pv.size(); i++){
+		p.do_move(pv[i], states[i]);
+	}
+	int wdl, plies;
+	while((pv.size() < size_t(MAX_PLY)) && probe(p, wdl, plies)){
+		if(wdl ? (p.state()->fifty_ct + plies > 100) : (pv.size() >= 2)) break; // (as in search(), the 50 move rule would draw it first)
+		const Move m = best_move(p);
+		if(m == MOVE_NONE) break;
+		p.do_move(m, states[pv.size()]);
+		pv.push_back(m);
+	}
+}
+
+bool Tablebases::generate(const TB_Options& op){
+	build_tables();
+	std::vector<bool> want(Tables.size(), false);
+	if(!op.only.empty()){
+		if(!TablesByCode.count(op.only)){
+			Error("Unknown tablebase '" + op.only + "' (codes look like KRKP, with the stronger side first).");
+		}
+		add_with_children(TablesByCode[op.only], want);
+	} else {
+		for(size_t i = 0; i < Tables.size(); i++){
+			want[i] = (Tables[i]->men <= op.max_men);
+		}
+	}
+	mkdir(op.path.c_str(), 0755);
+	bool ok = true;
+	for(size_t i = 0; i < Tables.size(); i++){
+		TBTable* t = Tables[i];
+		if(!want[i] || t->wdl) continue;
+		if(!map_table(t, op.path)){
+			ok &= generate_table(t, op);
+			if(!map_table(t, op.path)){
+				Error("Could not map tablebase '" + t->code + "' after generating it.");
+			}
+		}
+		register_table(t);
+		Cardinality = std::max(Cardinality, t->men);
+	}
+	return ok;
+}
@@ -0,0 +1,39 @@
+#ifndef TABLEBASE_INC
+#define TABLEBASE_INC
+
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+
+/*
+* Local endgame tablebases, generated by '-gentb' and memory-mapped for probing.
+* There is one file per material signature (e.g. "KRKP.ctb", the first group of pieces is always white in the file)
+* with a 2 bit result per position (draw, win, loss or not a legal position for the side to move), followed by
+* one byte per position with the distance in moves: the side to move mates in (2 * v - 1) plies, or gets mated
+* in (2 * v) plies (and draws only need the first part).
+* Positions are indexed by the king pair (white king in the a1-d1-d4 triangle, or on files A-D with pawns: 462 or
+* 1806 pairs), each group of like pieces as one combination of squares, and the side to move, so a 4 man table
+* without like pieces has 462 * 64 * 64 * 2 positions (4.5 MB on disk) and a 5 man one 64 times that.
+* Note: The distances ignore the 50 move rule, and there are no tables where both sides have pawns (so e.p. never matters).
+*/
+
+struct TB_Options {
+	size_t threads; // number of threads to split each generation pass across
+	int max_men; // generate every table with up to this many pieces (kings included)
+	std::string path; // directory to write the tables to
+	std::string only; // if set, only generate this signature (and whatever it converts into)
+};
+
+namespace Tablebases {
+	const int MaxMen = 5;
+	extern int Cardinality; // the most pieces in any table that can be probed (0 = no tables)
+
+	void init(const std::string& path, int probe_limit = MaxMen); // map every table in the directory (replacing any mapped before)
+	bool probe(const Board& pos, int& wdl, int& plies); // wdl is 1/0/-1 for the side to move, plies is the distance to mate
+	void filter_root_moves(const Board& pos, std::vector<Move>& moves); // keep only the moves that preserve the best result
+	Move best_move(const Board& pos); // the fastest win (or slowest loss), MOVE_NONE if there are no moves or tables for them
+	void extend_pv(const Board& pos, std::vector<Move>& pv); // carry on a PV from the root that ends in a table position
+	bool generate(const TB_Options& op); // generate (and then map) any missing tables
+}
+
+#endif // #ifndef TABLEBASE_INC
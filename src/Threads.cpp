@@ -5,6 +5,7 @@
 #include "Evaluation.h"
 #include "Search.h"
 #include "Threads.h"
+#include "Tablebase.h"
 
 ThreadPool Threads;
 
@@ -39,6 +40,31 @@ void TimerThread::idle_loop(void){
 	}
 }
 
+void SearchThread::idle_loop(void){
+	// A helper thread sleeps until it is given a root position by
+	// ThreadPool::start_helpers(), then runs its own search of it.
+	while(!exit){
+		mutex.lock();
+		while(!searching && !exit){
+			sleep_cond.wait(mutex);
+		}
+		mutex.unlock();
+		if(!exit){
+			search_loop();
+			mutex.lock();
+			searching = false;
+			sleep_cond.notify_one(); // the main thread may be waiting on us in wait_for_helpers()
+			mutex.unlock();
+		}
+	}
+}
+
+void SearchThread::clear(void){
+	history.clear();
+	counter_moves.clear();
+	cont_history.clear();
+}
+
 void MainThread::idle_loop(void){
 	// The main thread does the main searching and thinking (and launches
 	// all new searches).
@@ -67,18 +93,136 @@ extern "C" void* thread_start_func(void* th_v){
 	return 0;
 }
 
+void start_thread(ThreadBase* th){
+	pthread_create(th->get_handle(), NULL, thread_start_func, th); // th = parameter to thread_start_func
+}
+
+void join_thread(ThreadBase* th){
+	pthread_join(*th->get_handle(), NULL);
+}
+
+void run_jobs(size_t num, void* (*job)(void*), void* arg){
+	std::vector<JobThread*> threads;
+	for(size_t i = 0; i < std::max(num, size_t(1)); i++){
+		threads.push_back(new JobThread(job, arg));
+		start_thread(threads.back());
+	}
+	for(JobThread* th : threads){
+		join_thread(th);
+		delete th;
+	}
+}
+
 template<typename T>
 T* new_thread(void){
 	T* th = new T();
-	pthread_create(th->get_handle(), NULL, thread_start_func, th); // th = parameter to thread_start_func
+	start_thread(th);
 	return th;
 }
 
+void delete_thread(ThreadBase* th){
+	th->mutex.lock();
+	th->exit = true; // the idle loop will return once it is woken up
+	th->sleep_cond.notify_one();
+	th->mutex.unlock();
+	join_thread(th);
+	delete th;
+}
+
 void ThreadPool::init(void){
 	timer = new_thread<TimerThread>();
 	main_thread = new_thread<MainThread>();
 }
 
+void ThreadPool::set_size(size_t num){
+	// Note: Must not be called while searching. //
+	assert(num >= 1);
+	while(size() < num){
+		SearchThread* th = new_thread<SearchThread>();
+		th->idx = size();
+		helpers.push_back(th);
+	}
+	while(size() > num){
+		delete_thread(helpers.back());
+		helpers.pop_back();
+	}
+}
+
+uint64_t ThreadPool::nodes_searched(void) const {
+	uint64_t nodes = main_thread->nodes;
+	for(const SearchThread* th : helpers){
+		nodes += th->nodes;
+	}
+	return nodes;
+}
+
+void ThreadPool::resize_eval_caches(size_t mbSize){
+	Eval::CacheSize = mbSize;
+	main_thread->eval_cache.resize(mbSize);
+	for(SearchThread* th : helpers){
+		th->eval_cache.resize(mbSize);
+	}
+}
+
+void ThreadPool::eval_cache_stats(uint64_t& hits, uint64_t& probes) const {
+	hits = main_thread->eval_cache.hits;
+	probes = main_thread->eval_cache.probes;
+	for(const SearchThread* th : helpers){
+		hits += th->eval_cache.hits;
+		probes += th->eval_cache.probes;
+	}
+}
+
+void ThreadPool::lazy_eval_stats(uint64_t& exits, uint64_t& tries) const {
+	exits = main_thread->lazy_exits;
+	tries = main_thread->lazy_tries;
+	for(const SearchThread* th : helpers){
+		exits += th->lazy_exits;
+		tries += th->lazy_tries;
+	}
+}
+
+void ThreadPool::cutoff_stats(uint64_t& total, uint64_t& first, uint64_t& second) const {
+	total = main_thread->cutoffs;
+	first = main_thread->cutoffs_first;
+	second = main_thread->cutoffs_second;
+	for(const SearchThread* th : helpers){
+		total += th->cutoffs;
+		first += th->cutoffs_first;
+		second += th->cutoffs_second;
+	}
+}
+
+uint64_t ThreadPool::tb_hits(void) const {
+	uint64_t hits = main_thread->tb_hits;
+	for(const SearchThread* th : helpers){
+		hits += th->tb_hits;
+	}
+	return hits;
+}
+
+void ThreadPool::start_helpers(void){
+	for(SearchThread* th : helpers){
+		th->mutex.lock();
+		th->root_pos = Search::RootPos;
+		th->root_pos.set_thread(th);
+		th->root_moves = Search::RootMoves;
+		th->searching = true;
+		th->sleep_cond.notify_one();
+		th->mutex.unlock();
+	}
+}
+
+void ThreadPool::wait_for_helpers(void){
+	for(SearchThread* th : helpers){
+		th->mutex.lock();
+		while(th->searching){
+			th->sleep_cond.wait(th->mutex);
+		}
+		th->mutex.unlock();
+	}
+}
+
 void ThreadPool::start_searching(const Board& pos, const Search::SearchLimits& limits, Search::BoardStateStack& states){
 	// First, wait for the main thread to finish thinking. //
 	//printf("Waiting for main thread to finish thinking...\n");
@@ -91,6 +235,17 @@ void ThreadPool::start_searching(const Board& pos, const Search::SearchLimits& l
 	Search::Signals.stop = Search::Signals.stop_on_ponder_hit = false;
 	Search::Signals.failed_low_at_root = Search::Signals.first_root_move = false;
 	Search::RootMoves.clear();
+	// Reset the counters here (not in the threads) so the timer never sees stale ones. //
+	main_thread->nodes = main_thread->tb_hits = main_thread->max_ply = 0;
+	main_thread->eval_cache.hits = main_thread->eval_cache.probes = 0;
+	main_thread->lazy_tries = main_thread->lazy_exits = 0;
+	main_thread->cutoffs = main_thread->cutoffs_first = main_thread->cutoffs_second = 0;
+	for(SearchThread* th : helpers){
+		th->nodes = th->tb_hits = th->max_ply = 0;
+		th->eval_cache.hits = th->eval_cache.probes = 0;
+		th->lazy_tries = th->lazy_exits = 0;
+		th->cutoffs = th->cutoffs_first = th->cutoffs_second = 0;
+	}
 	Search::RootPos = pos;
 	Search::Limits = limits;
 	if(states.get()){ // if there's nothing, preserve current BoardStateStack
@@ -99,11 +254,16 @@ void ThreadPool::start_searching(const Board& pos, const Search::SearchLimits& l
 		assert(!states.get()); // we have transferred ownership above
 	}
 	//printf("Adding root moves...\n");
+	std::vector<Move> root_moves;
 	for(MoveList<LEGAL> it(pos); *it; it++){
 		if(limits.SearchMoves.empty() || std::count(limits.SearchMoves.begin(), limits.SearchMoves.end(), *it)){
-			Search::RootMoves.push_back(Search::RootMove(*it));
+			root_moves.push_back(*it);
 		}
 	}
+	Tablebases::filter_root_moves(pos, root_moves); // with a table for the root, only search the moves that keep the best result
+	for(const Move m : root_moves){
+		Search::RootMoves.push_back(Search::RootMove(m));
+	}
 	//printf("Notifying main thread...\n");
 	main_thread->thinking = true;
 	main_thread->notify_one(); // let's get thinking
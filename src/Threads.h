@@ -5,6 +5,10 @@
 #include "Bitboards.h"
 #include "Board.h"
 #include "Search.h"
+#include "MoveSort.h"
+#include "Pawns.h"
+#include "Material.h"
+#include "Evaluation.h"
 
 struct Mutex {
 	/* A simple wrapper around a mutex. */
@@ -87,9 +91,37 @@ struct ThreadBase {
 	}
 };
 
-struct MainThread : public ThreadBase {
+struct SearchThread : public ThreadBase {
+	/* A thread that runs its own iterative deepening loop (Lazy SMP). */
+	Board root_pos; // our own copy of the root position
+	Search::RootMoveVector root_moves; // our own root moves (and their scores/PV's)
+	HistoryTable history; // history table for move ordering
+	CounterMovesTable counter_moves; // counter move table for move ordering
+	ContinuationHistory cont_history; // continuation history for move ordering
+	Pawns::PawnTable pawns_table; // pawn hash table
+	Material::MaterialTable material_table; // material hash table
+	Eval::EvalCache eval_cache; // full evaluation cache
+	size_t idx; // index in the thread pool (0 = main thread)
+	size_t PVIdx; // the PV line we are searching right now
+	Depth completed_depth; // the last depth we have fully searched
+	uint64_t nodes; // nodes searched by this thread
+	uint64_t tb_hits; // successful tablebase probes by this thread
+	uint64_t lazy_tries, lazy_exits; // qsearch evaluations that could have exited early, and the ones that did
+	uint64_t cutoffs, cutoffs_first, cutoffs_second; // beta cutoffs, and the ones by the first and second move (for measuring move ordering)
+	int max_ply; // the highest ply reached (seldepth)
+	volatile bool searching; // whether the thread is searching or not
+	
+	SearchThread(void) : idx(0), PVIdx(0), completed_depth(DEPTH_ZERO), nodes(0), tb_hits(0), lazy_tries(0), lazy_exits(0), cutoffs(0), cutoffs_first(0), cutoffs_second(0), max_ply(0), searching(false) {
+		eval_cache.resize(Eval::CacheSize);
+		clear();
+	}
+	void clear(void); // clear all of the move ordering tables
+	virtual void idle_loop(void);
+	void search_loop(void); // main iterative deepening loop
+};
+
+struct MainThread : public SearchThread {
 	volatile bool thinking; // whether the thread is thinking or not
-	volatile bool searching;
 	
 	MainThread(void) : thinking(true) {}
 	virtual void idle_loop(void);
@@ -103,12 +135,38 @@ struct TimerThread : public ThreadBase {
 	virtual void idle_loop(void);
 };
 
+struct JobThread : public ThreadBase {
+	/* A thread that runs a single job (e.g. a share of a perft) instead of waiting for searches. */
+	void* (*job)(void*); // what to run
+	void* arg; // and what to run it with
+	
+	JobThread(void* (*j)(void*), void* a) : job(j), arg(a) {}
+	virtual void idle_loop(void){
+		job(arg);
+	}
+};
+
+void start_thread(ThreadBase* th); // launch th's idle loop on a thread of its own
+void join_thread(ThreadBase* th); // wait until th's idle loop returns
+void run_jobs(size_t num, void* (*job)(void*), void* arg); // run the same job on 'num' threads at once and wait for all of them
+
 struct ThreadPool {
 	MainThread* main_thread;
 	TimerThread* timer;
+	std::vector<SearchThread*> helpers; // helper threads (besides the main thread)
 	
 	void init(void);
+	void set_size(size_t num); // set the total number of search threads (incl. the main thread)
+	size_t size(void) const { return helpers.size() + 1; }
+	uint64_t nodes_searched(void) const; // total nodes searched by all threads
+	uint64_t tb_hits(void) const; // total tablebase hits by all threads
+	void resize_eval_caches(size_t mbSize); // resize every thread's evaluation cache (not while searching)
+	void eval_cache_stats(uint64_t& hits, uint64_t& probes) const; // evaluation cache hits and probes by all threads
+	void lazy_eval_stats(uint64_t& exits, uint64_t& tries) const; // lazy evaluation exits and tries by all threads
+	void cutoff_stats(uint64_t& total, uint64_t& first, uint64_t& second) const; // beta cutoffs by all threads (and how many were by the first/second move)
 	void start_searching(const Board& pos, const Search::SearchLimits& limits, Search::BoardStateStack& states);
+	void start_helpers(void); // launch the helpers on the current root position
+	void wait_for_helpers(void); // wait until all helpers have stopped searching
 };
 
 extern ThreadPool Threads;
@@ -0,0 +1,473 @@
+#include "Common.h"
+#include "Bitboards.h"
+#include "Board.h"
+#include "Search.h"
+#include "Evaluation.h"
+#include "Pawns.h"
+#include "Material.h"
+#include "Threads.h"
+#include "TT.h"
+#include "PGN.h"
+#include "NNUE.h"
+#include "UCI.h"
+#include "Tune.h"
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <glob.h>
+
+namespace {
+	const int SkipPlies = 16; // opening moves are mostly book moves, so their positions say little about the evaluation
+	const int RetryEpochs = 10; // how often parameters that made no difference are tried again
+	const double Beta1 = 0.9, Beta2 = 0.999, Epsilon = 1e-12; // Adam
+	const int MobilityCount[] = { 0, 0, 9, 14, 15, 28 }; // entries in each row of MobilityBonus
+
+	struct Param {
+		// One tunable integer: either an int or one half of a Score. //
+		int* value; // for Weights and the imbalance tables
+		Score* score; // for everything else
+		Score* mirror; // the square/file on the other side of the board, which always gets the same value (if/a)
+		bool eg; // which half of the score
+		bool material; // cached in the material tables
+
+		int get(void) const {
+			if(value) return *value;
+			return eg ? eg_value(*score) : mg_value(*score);
+		}
+
+		void set(int v){
+			if(value){
+				*value = v;
+				return;
+			}
+			*score = eg ? make_score(mg_value(*score), v) : make_score(v, eg_value(*score));
+			if(mirror) *mirror = eg ? make_score(mg_value(*mirror), v) : make_score(v, eg_value(*mirror));
+		}
+	};
+
+	std::vector<Param> Params;
+
+	void add_int(int& v, bool material){
+		Param p = { &v, NULL, NULL, false, material };
+		Params.push_back(p);
+	}
+
+	void add_score(Score& s, Score* mirror){
+		for(int eg = 0; eg < 2; eg++){
+			Param p = { NULL, &s, mirror, bool(eg), false };
+			Params.push_back(p);
+		}
+	}
+
+	void init_params(void){
+		Params.clear();
+		for(Weight& w : Weights){
+			add_int(w.mg, false);
+			add_int(w.eg, false);
+		}
+		for(PieceType pt = KNIGHT; pt <= QUEEN; pt++){
+			for(int i = 0; i < MobilityCount[pt]; i++){
+				add_score(MobilityBonus[pt][i], NULL);
+			}
+		}
+		// The tables are symmetrical, so only the queenside is tuned. //
+		for(PieceType pt = PAWN; pt <= KING; pt++){
+			for(Rank r = (pt == PAWN ? RANK_2 : RANK_1); r <= (pt == PAWN ? RANK_7 : RANK_8); r++){
+				for(File f = FILE_A; f <= FILE_D; f++){
+					add_score(Eval::PieceSquareTable[pt][make_square(r, f)], &Eval::PieceSquareTable[pt][make_square(r, File(FILE_H - f))]);
+				}
+			}
+		}
+		for(File f = FILE_A; f <= FILE_D; f++){
+			add_score(Doubled[f], &Doubled[FILE_H - f]);
+			for(int opposed = 0; opposed < 2; opposed++){
+				add_score(Isolated[opposed][f], &Isolated[opposed][FILE_H - f]);
+				add_score(Backward[opposed][f], &Backward[opposed][FILE_H - f]);
+			}
+		}
+		for(PieceType i = PAWN; i <= QUEEN; i++){
+			for(PieceType j = PAWN; j <= i; j++){
+				add_int(QuadraticOurs[i][j], true);
+				add_int(QuadraticTheirs[i][j], true);
+			}
+		}
+	}
+
+	// Extraction //
+
+	struct TunePos {
+		PackedBoard pos;
+		uint8_t result; // in half points for white
+	};
+
+	struct ExtractWork {
+		// Shared by all of the extraction threads: each one takes the next game until there are none left. //
+		const std::vector<PGN_Game>* games;
+		std::vector<std::vector<TunePos> > found; // by game (so the order does not depend on the threads)
+		size_t next;
+		Mutex mutex;
+	};
+
+	void extract_game(const PGN_Game& game, SearchThread* th, std::vector<TunePos>& out){
+		const uint8_t result = (game.res == WhiteWin) ? 2 : ((game.res == BlackWin) ? 0 : 1);
+		std::map<PGN_Ext_Tag, std::string>::const_iterator fen = game.opts.addl.find(FEN);
+		Board pos;
+		pos.init_from((fen != game.opts.addl.end()) ? fen->second : std::string(StartFEN));
+		pos.set_thread(th);
+		std::deque<BoardState> states; // the board keeps pointers to these (for repetitions)
+		std::vector<Move> pv;
+		BoardState pv_states[MAX_PLY];
+		for(size_t ply = 0; ply < game.moves.size(); ply++){
+			if((int(ply) >= SkipPlies) && !pos.checkers() && !pos.is_draw(0)){
+				const Value v = Search::quiesce(pos, pv);
+				if(std::abs(v) < VAL_KNOWN_WIN){
+					// Go to the end of the PV, where the static evaluation should agree with the search. //
+					for(size_t i = 0; i < pv.size(); i++){
+						pos.do_move(pv[i], pv_states[i]);
+					}
+					if(!pos.checkers() && !Material::probe(pos)->specialized_eval_exists()){
+						TunePos tp;
+						pos.pack(tp.pos);
+						tp.result = result;
+						out.push_back(tp);
+					}
+					for(size_t i = pv.size(); i > 0; i--){
+						pos.undo_move(pv[i - 1]);
+					}
+				}
+			}
+			const Move m = game.moves[ply].enc;
+			if(!pos.pseudo_legal(m) || !pos.legal(m, pos.pinned(pos.side_to_move()))){
+				break; // the rest of the game is unusable
+			}
+			states.push_back(BoardState());
+			pos.do_move(m, states.back());
+		}
+	}
+
+	void* extract_thread_func(void* arg){
+		ExtractWork* w = (ExtractWork*)arg;
+		SearchThread* th = new SearchThread(); // only for its tables (it never searches)
+		while(true){
+			w->mutex.lock();
+			const size_t i = w->next++;
+			w->mutex.unlock();
+			if(i >= w->games->size()) break;
+			extract_game((*w->games)[i], th, w->found[i]);
+		}
+		delete th;
+		return NULL;
+	}
+
+	// Error //
+
+	struct ErrorWork {
+		// One slice of the positions per thread. //
+		const PackedBoard* positions;
+		size_t n;
+		Value* values; // white's point of view
+		SearchThread* th;
+		bool clear_material; // an imbalance table changed since the last pass
+	};
+
+	void* error_thread_func(void* arg){
+		ErrorWork* w = (ErrorWork*)arg;
+		if(w->clear_material) w->th->material_table.clear();
+		Eval::evaluate_batch(w->positions, w->n, w->values, w->th);
+		for(size_t i = 0; i < w->n; i++){
+			if(w->positions[i].to_move == BLACK) w->values[i] = -w->values[i];
+		}
+		return NULL;
+	}
+
+	inline double sigmoid(double K, Value v){
+		return 1.0 / (1.0 + std::pow(10.0, -K * Eval::to_cp(v) / 4.0));
+	}
+
+	class Tuner {
+		private:
+			std::vector<PackedBoard> positions;
+			std::vector<uint8_t> results; // in half points for white
+			std::vector<Value> values; // white's point of view
+			std::vector<ErrorWork> work;
+			double K;
+			bool material_changed;
+			uint64_t passes;
+		public:
+			Tuner(const std::vector<TunePos>& pos, size_t threads) : K(1.0), material_changed(false), passes(0) {
+				for(const TunePos& tp : pos){
+					positions.push_back(tp.pos);
+					results.push_back(tp.result);
+				}
+				values.assign(positions.size(), VAL_ZERO);
+				work.resize(std::max(size_t(1), std::min(threads, positions.size())));
+				const size_t per = (positions.size() + work.size() - 1) / work.size();
+				for(size_t t = 0; t < work.size(); t++){
+					ErrorWork& w = work[t];
+					const size_t begin = std::min(t * per, positions.size());
+					w.positions = positions.data() + begin;
+					w.n = std::min(per, positions.size() - begin);
+					w.values = values.data() + begin;
+					w.th = new SearchThread();
+					w.clear_material = true;
+				}
+			}
+
+			~Tuner(void){
+				for(ErrorWork& w : work) delete w.th;
+			}
+
+			size_t size(void) const { return positions.size(); }
+			uint64_t evaluated(void) const { return passes * positions.size(); }
+
+			void changed(const Param& p){
+				material_changed |= p.material;
+			}
+
+			void evaluate_all(void){
+				// Fill 'values' with the current tables. //
+				std::vector<JobThread*> threads;
+				for(size_t t = 0; t < work.size(); t++){
+					work[t].clear_material = material_changed;
+					threads.push_back(new JobThread(error_thread_func, &work[t])); // every thread has its own share
+					start_thread(threads.back());
+				}
+				for(JobThread* th : threads){
+					join_thread(th);
+					delete th;
+				}
+				material_changed = false;
+				++passes;
+			}
+
+			double error(double k) const {
+				double sum = 0.0;
+				for(size_t i = 0; i < positions.size(); i++){
+					const double d = 0.5 * results[i] - sigmoid(k, values[i]);
+					sum += d * d;
+				}
+				return sum / positions.size();
+			}
+
+			double error(void){
+				evaluate_all();
+				return error(K);
+			}
+
+			double fit_k(void){
+				// Golden section search for the scaling constant that fits the current evaluation best. //
+				evaluate_all();
+				const double G = (std::sqrt(5.0) - 1.0) / 2.0;
+				double a = 0.05, b = 5.0;
+				double c = b - G * (b - a), d = a + G * (b - a);
+				double fc = error(c), fd = error(d);
+				while(b - a > 1e-4){
+					if(fc < fd){
+						b = d; d = c; fd = fc;
+						c = b - G * (b - a); fc = error(c);
+					} else {
+						a = c; c = d; fc = fd;
+						d = a + G * (b - a); fd = error(d);
+					}
+				}
+				K = (a + b) / 2.0;
+				return K;
+			}
+	};
+
+	// Output //
+
+	std::string score_str(Score s){
+		char buf[32];
+		snprintf(buf, sizeof(buf), "S(%4d,%4d)", int(mg_value(s)), int(eg_value(s)));
+		return buf;
+	}
+
+	void write_tables(const std::string& fname, size_t n, int epoch, double err){
+		std::ofstream ofp(fname);
+		if(!ofp.is_open()){
+			Error("Could not open output file '" + fname + "' for writing.");
+		}
+		const char* const PieceNames[] = { "", "Pawn", "Knight", "Bishop", "Rook", "Queen", "King" };
+		const char* const WeightNames[] = { "Mobility", "PawnStructure", "PassedPawns", "Space", "KingSafety" };
+		ofp << "// Tuned on " << n << " positions (epoch " << epoch << ", error " << err << ") //\n\n";
+		// Evaluation.cpp //
+		ofp << "Weight Weights[] = {\n\t";
+		for(int i = 0; i < 5; i++){
+			ofp << "{" << Weights[i].mg << ", " << Weights[i].eg << "}" << (i < 4 ? ", " : "\n");
+		}
+		ofp << "}; // weights by [";
+		for(int i = 0; i < 5; i++){
+			ofp << WeightNames[i] << (i < 4 ? ", " : "]\n\n");
+		}
+		ofp << "Score Eval::PieceSquareTable[][SQUARE_NB] = {\n\t{ },\n";
+		for(PieceType pt = PAWN; pt <= KING; pt++){
+			ofp << "\t{ // " << PieceNames[pt] << "\n";
+			for(Square s = SQ_A1; s <= SQ_H8; s++){
+				ofp << (file_of(s) == FILE_A ? "\t\t" : " ") << score_str(Eval::PieceSquareTable[pt][s]);
+				ofp << (s == SQ_H8 ? "\n" : (file_of(s) == FILE_H ? ",\n" : ","));
+			}
+			ofp << (pt == KING ? "\t}\n" : "\t},\n");
+		}
+		ofp << "};\n\n";
+		ofp << "Score MobilityBonus[][32] = {\n\t{}, // NO_PIECE_TYPE\n\t{}, // Pawns (handled separately)\n";
+		for(PieceType pt = KNIGHT; pt <= QUEEN; pt++){
+			ofp << "\t{ // " << PieceNames[pt] << "s\n";
+			for(int i = 0; i < MobilityCount[pt]; i++){
+				ofp << (i % 6 ? " " : "\t\t") << score_str(MobilityBonus[pt][i]);
+				ofp << ((i + 1 == MobilityCount[pt]) ? "\n" : ((i % 6 == 5) ? ",\n" : ","));
+			}
+			ofp << (pt == QUEEN ? "\t}\n" : "\t},\n");
+		}
+		ofp << "};\n\n";
+		// Pawns.cpp //
+		ofp << "Score Doubled[FILE_NB] = {\n\t";
+		for(File f = FILE_A; f <= FILE_H; f++){
+			ofp << score_str(Doubled[f]) << (f == FILE_H ? "\n" : ", ");
+		}
+		ofp << "};\n\n";
+		const char* const PawnTableNames[] = { "Isolated", "Backward" };
+		Score (* const PawnTables[])[FILE_NB] = { Isolated, Backward };
+		for(int t = 0; t < 2; t++){
+			ofp << "Score " << PawnTableNames[t] << "[2][FILE_NB] = {\n";
+			for(int opposed = 0; opposed < 2; opposed++){
+				ofp << "\t{\n\t\t";
+				for(File f = FILE_A; f <= FILE_H; f++){
+					ofp << score_str(PawnTables[t][opposed][f]) << (f == FILE_H ? "\n" : ", ");
+				}
+				ofp << (opposed ? "\t}\n" : "\t},\n");
+			}
+			ofp << "};\n\n";
+		}
+		// Material.cpp //
+		const char* const QuadNames[] = { "QuadraticOurs", "QuadraticTheirs" };
+		int (* const QuadTables[])[PIECE_TYPE_NB] = { QuadraticOurs, QuadraticTheirs };
+		for(int t = 0; t < 2; t++){
+			ofp << "int " << QuadNames[t] << "[][PIECE_TYPE_NB] = {\n\t{ 0 }, // None\n";
+			for(PieceType i = PAWN; i <= QUEEN; i++){
+				ofp << "\t{ 0";
+				for(PieceType j = PAWN; j <= i; j++){
+					ofp << ", " << QuadTables[t][i][j];
+				}
+				ofp << (i == QUEEN ? " }  // " : " }, // ") << PieceNames[i] << "\n";
+			}
+			ofp << "};\n\n";
+		}
+	}
+}
+
+bool Tune::run(const Tune_Options& op){
+	if(NNUE::Enabled){
+		Warn("The network is not tuned, tuning the handcrafted evaluation.");
+		NNUE::Enabled = false;
+	}
+	// Read the games. //
+	std::vector<PGN_Game> games;
+	glob_t g;
+	if(glob((op.path + "/*.pgn").c_str(), 0, NULL, &g) == 0){
+		for(size_t i = 0; i < g.gl_pathc; i++){
+			std::ifstream ifp(g.gl_pathv[i]);
+			if(!ifp.is_open()){
+				Warn("Could not open '" + std::string(g.gl_pathv[i]) + "', skipping it.");
+				continue;
+			}
+			PGN_Reader reader;
+			reader.init(ReadEntireFile(ifp));
+			reader.read_all();
+			size_t used = 0;
+			for(PGN_Game& game : reader.get_game_vector()){
+				if((game.res == WhiteWin) || (game.res == BlackWin) || (game.res == Draw)){
+					games.push_back(game);
+					++used;
+				}
+			}
+			printf("%s: %zu game(s) with a result\n", g.gl_pathv[i], used);
+		}
+	}
+	globfree(&g);
+	if(games.empty()){
+		Warn("No finished games in '" + op.path + "/*.pgn'.");
+		return false;
+	}
+	// Extract and pack the quiet positions. //
+	int64_t start = get_system_time_msec();
+	TT.clear();
+	ExtractWork ew;
+	ew.games = &games;
+	ew.found.resize(games.size());
+	ew.next = 0;
+	run_jobs(std::min(op.threads, games.size()), extract_thread_func, &ew);
+	std::vector<TunePos> packed;
+	for(std::vector<TunePos>& v : ew.found){
+		for(TunePos& tp : v){
+			if(op.max_positions && (packed.size() >= op.max_positions)) break;
+			packed.push_back(tp);
+		}
+		std::vector<TunePos>().swap(v);
+	}
+	std::vector<PGN_Game>().swap(games);
+	printf("%zu quiet position(s), %.1f MB packed, %" PRId64 " ms\n", packed.size(),
+		double(packed.size() * sizeof(TunePos)) / (1024 * 1024), get_system_time_msec() - start);
+	if(packed.empty()){
+		Warn("No quiet positions to tune on.");
+		return false;
+	}
+	// Tune. //
+	Tuner tuner(packed, op.threads);
+	std::vector<TunePos>().swap(packed);
+	init_params();
+	const double K = tuner.fit_k();
+	double best = tuner.error();
+	printf("K = %.4f, error = %.8f, %zu parameter(s)\n", K, best, Params.size());
+	std::vector<double> x(Params.size()), m(Params.size(), 0.0), v(Params.size(), 0.0), grad(Params.size());
+	std::vector<bool> active(Params.size(), true);
+	for(size_t i = 0; i < Params.size(); i++) x[i] = Params[i].get();
+	for(int epoch = 1; epoch <= op.epochs; epoch++){
+		start = get_system_time_msec();
+		const uint64_t evaluated = tuner.evaluated();
+		const double e0 = tuner.error();
+		size_t tuned = 0;
+		for(size_t i = 0; i < Params.size(); i++){
+			grad[i] = 0.0;
+			if(!active[i] && (epoch % RetryEpochs)) continue;
+			// Central difference (the parameters are integers, so the smallest step is 1). //
+			Param& p = Params[i];
+			const int old = p.get();
+			p.set(old + 1);
+			tuner.changed(p);
+			Eval::init();
+			const double up = tuner.error();
+			p.set(old - 1);
+			tuner.changed(p);
+			Eval::init();
+			const double down = tuner.error();
+			p.set(old);
+			tuner.changed(p);
+			Eval::init();
+			active[i] = (up != e0) || (down != e0);
+			grad[i] = (up - down) / 2.0;
+			tuned += active[i];
+		}
+		// Adam step (on a real-valued shadow of each parameter, so small steps add up). //
+		const double c1 = 1.0 - std::pow(Beta1, epoch), c2 = 1.0 - std::pow(Beta2, epoch);
+		for(size_t i = 0; i < Params.size(); i++){
+			if(!active[i]) continue;
+			m[i] = Beta1 * m[i] + (1.0 - Beta1) * grad[i];
+			v[i] = Beta2 * v[i] + (1.0 - Beta2) * grad[i] * grad[i];
+			x[i] -= op.rate * (m[i] / c1) / (std::sqrt(v[i] / c2) + Epsilon);
+			Params[i].set(int(std::lround(x[i])));
+			tuner.changed(Params[i]);
+		}
+		Eval::init();
+		best = tuner.error();
+		const int64_t elapsed = std::max(get_system_time_msec() - start, int64_t(1));
+		const uint64_t n = tuner.evaluated() - evaluated;
+		printf("epoch %3d  error %.8f -> %.8f  %zu active  %" PRIu64 " positions/s  %" PRId64 " ms\n",
+			epoch, e0, best, tuned, (n * 1000) / uint64_t(elapsed), elapsed);
+		fflush(stdout);
+		write_tables(op.out, tuner.size(), epoch, best);
+	}
+	if(op.epochs < 1) write_tables(op.out, tuner.size(), 0, best);
+	printf("Tables written to '%s'.\n", op.out.c_str());
+	return true;
+}
@@ -0,0 +1,31 @@
+#ifndef TUNE_INC
+#define TUNE_INC
+
+#include "Common.h"
+#include "Board.h"
+
+/*
+* Texel tuning of the evaluation tables: Weights, MobilityBonus, Eval::PieceSquareTable, the pawn structure
+* penalties (Doubled, Isolated, Backward) and the material imbalance tables (QuadraticOurs/Theirs).
+* Positions are taken from PGN games and resolved to the end of their quiescence search PV (so that the
+* static evaluation is meaningful), then packed into memory with the result of their game.
+* The tables are adjusted to minimize the mean squared error b/w the results and sigmoid(K * eval):
+* every epoch estimates the gradient by central differences (each parameter is an integer, so by +/- 1)
+* with the positions split across threads, then takes an Adam step.
+* The tuned tables are written out as C++ after every epoch.
+*/
+
+struct Tune_Options {
+	size_t threads; // number of threads to split the positions across
+	int epochs; // number of gradient steps
+	double rate; // learning rate (about how far a parameter can move in one epoch)
+	size_t max_positions; // only use the first this many positions (0 = all)
+	std::string path; // directory to read the PGN files from
+	std::string out; // file to write the tuned tables to
+};
+
+namespace Tune {
+	bool run(const Tune_Options& op); // returns false if there were no positions to tune on
+}
+
+#endif // #ifndef TUNE_INC
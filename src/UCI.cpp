@@ -6,12 +6,25 @@
 #include "Search.h"
 #include "Threads.h"
 #include "UCI.h"
+#include "TT.h"
+#include "Tablebase.h"
+#include "NNUE.h"
 #include <fstream>
 #include <ostream>
 
 namespace {
 	Board MainBoard;
 	Search::BoardStateStack BSS;
+	std::string TBPath = ""; // directory of the mapped tablebases (empty = none)
+	int TBProbeLimit = Tablebases::MaxMen; // do not probe positions with more pieces than this
+	bool UseNNUE = false; // whether the network should be used (once one is loaded)
+	
+	void set_evaluator(void){
+		// Cached evaluations (incl. the ones in the TT) are from the other evaluator now. //
+		NNUE::Enabled = UseNNUE && NNUE::loaded();
+		TT.clear();
+		Threads.resize_eval_caches(Eval::CacheSize);
+	}
 }
 
 std::string ENGINE_VERSION = "v0.1";
@@ -53,7 +66,7 @@ void handle_go(std::istringstream& ss){
 		else if(tok == "binc") ss >> limits.inc[BLACK];
 		else if(tok == "movestogo") ss >> limits.movestogo;
 		else if(tok == "depth") ss >> limits.depth;
-		else if(tok == "nodes") ss >> limits.nodes; // TODO: Finish implementing this, plus NPS stuff
+		else if(tok == "nodes") ss >> limits.nodes;
 		else if(tok == "mate") ss >> limits.mate;
 		else if(tok == "movetime") ss >> limits.movetime;
 		else if(tok == "infinite") limits.infinite = true;
@@ -92,6 +105,98 @@ void handle_position(std::istringstream& ss){
 	}
 }
 
+void wait_for_search(void){
+	// Some options can't be changed in the middle of a search. //
+	while(Threads.main_thread->thinking){
+		usleep(TimerThread::PollEvery);
+	}
+}
+
+void handle_setoption(std::istringstream& ss){
+	// "setoption name <id> [value <x>]"
+	// Note: 'ss' should have already consumed "setoption".
+	std::string tok, name = "", value = "";
+	ss >> tok; // consume "name"
+	while(ss >> tok && (tok != "value")){
+		name += (name.empty() ? "" : " ") + tok; // option names can have spaces
+	}
+	while(ss >> tok){
+		value += (value.empty() ? "" : " ") + tok;
+	}
+	if(name == "Hash"){
+		int mb = atoi(value.c_str());
+		if(mb < 1 || mb > 65536){
+			std::cout << "info string Hash must be between 1 and 65536 MB" << std::endl;
+			return;
+		}
+		wait_for_search();
+		TT.resize(mb);
+	} else if(name == "Clear Hash"){
+		wait_for_search();
+		Search::clear();
+	} else if(name == "MultiPV"){
+		int num = atoi(value.c_str());
+		if(num < 1 || num > 500){
+			std::cout << "info string MultiPV must be between 1 and 500" << std::endl;
+			return;
+		}
+		wait_for_search();
+		Search::MultiPV = num;
+	} else if(name == "Threads"){
+		int num = atoi(value.c_str());
+		if(num < 1 || num > 128){
+			std::cout << "info string Threads must be between 1 and 128" << std::endl;
+			return;
+		}
+		wait_for_search();
+		Threads.set_size(num);
+	} else if(name == "EvalCache"){
+		int mb = atoi(value.c_str());
+		if(mb < 0 || mb > 1024){
+			std::cout << "info string EvalCache must be between 0 and 1024 MB" << std::endl;
+			return;
+		}
+		wait_for_search();
+		Threads.resize_eval_caches(mb);
+	} else if(name == "LazyEvalMargin"){
+		int margin = atoi(value.c_str());
+		if(margin < 0 || margin > 5000){
+			std::cout << "info string LazyEvalMargin must be between 0 and 5000" << std::endl;
+			return;
+		}
+		wait_for_search();
+		Eval::LazyMargin = Value(margin);
+	} else if(name == "UseNNUE"){
+		wait_for_search();
+		UseNNUE = (value == "true");
+		if(UseNNUE && !NNUE::loaded()){
+			std::cout << "info string No network loaded yet (set EvalFile), using the classical evaluation" << std::endl;
+		}
+		set_evaluator();
+	} else if(name == "EvalFile"){
+		wait_for_search();
+		if(!NNUE::load(value)){
+			std::cout << "info string Could not load the network from '" << value << "'" << std::endl;
+			return;
+		}
+		std::cout << "info string Loaded the network from '" << value << "'" << std::endl;
+		set_evaluator();
+	} else if(name == "TablebasePath"){
+		wait_for_search();
+		TBPath = (value == "<empty>") ? "" : value;
+		Tablebases::init(TBPath, TBProbeLimit);
+	} else if(name == "TablebaseProbeLimit"){
+		int num = atoi(value.c_str());
+		if(num < 0 || num > Tablebases::MaxMen){
+			std::cout << "info string TablebaseProbeLimit must be between 0 and " << Tablebases::MaxMen << std::endl;
+			return;
+		}
+		wait_for_search();
+		TBProbeLimit = num;
+		Tablebases::init(TBPath, TBProbeLimit);
+	}
+}
+
 void UCI::loop(int argc, char** argv){
 	std::string inp = "", tok;
 	MainBoard.init_from(StartFEN);
@@ -106,6 +211,16 @@ void UCI::loop(int argc, char** argv){
 			std::cout << "id author Sumer Kohli" << std::endl;
 			// TODO: Send more options to GUI for customizing and handle 'setoption'
 			std::cout << std::endl;
+			std::cout << "option name Hash type spin default " << TranspositionTable::DefaultSize << " min 1 max 65536" << std::endl;
+			std::cout << "option name Clear Hash type button" << std::endl;
+			std::cout << "option name Threads type spin default 1 min 1 max 128" << std::endl;
+			std::cout << "option name MultiPV type spin default 1 min 1 max 500" << std::endl;
+			std::cout << "option name EvalCache type spin default " << Eval::EvalCache::DefaultSize << " min 0 max 1024" << std::endl; // per thread, 0 turns it off
+			std::cout << "option name LazyEvalMargin type spin default " << Eval::DefaultLazyMargin << " min 0 max 5000" << std::endl; // 0 turns lazy evaluation off
+			std::cout << "option name UseNNUE type check default false" << std::endl;
+			std::cout << "option name EvalFile type string default <empty>" << std::endl; // HalfKP 256x2-32-32 network file
+			std::cout << "option name TablebasePath type string default <empty>" << std::endl;
+			std::cout << "option name TablebaseProbeLimit type spin default " << Tablebases::MaxMen << " min 0 max " << Tablebases::MaxMen << std::endl;
 			std::cout << "option name Ponder type check default true" << std::endl; // declare our ability to ponder for polyglot
 			std::cout << "option name OwnBook type check default true" << std::endl; // we have our own opening book now
 			std::cout << "option name UCI_LimitStrength type check default false" << std::endl; // TODO: Estimated 2008 at ± 80 ELO rating, try limiting it - but by skill parameter rather than ELO?
@@ -113,11 +228,14 @@ void UCI::loop(int argc, char** argv){
 		} else if(tok == "isready"){
 			std::cout << "readyok" << std::endl;
 		} else if(tok == "ucinewgame"){
-			// TODO: Clear TT, etc.
+			wait_for_search();
+			Search::clear();
 			MainBoard.init_from(StartFEN);
 			BSS.release(); // release ownership and free memory
 		} else if(tok == "position"){
 			handle_position(ss);
+		} else if(tok == "setoption"){
+			handle_setoption(ss);
 		} else if(tok == "disp"){
 			std::cerr << MainBoard << std::endl;
 		} else if(tok == "go"){